@@ -0,0 +1,29 @@
+#ifndef DEVICE_H
+#define DEVICE_H
+
+#include <signal.h>
+
+// A source of power values, selected on the command line as '<name>[:<argument>]'.
+// Only one device is open at a time, so the devices keep their state in static variables.
+struct power_device
+{
+	const char *name;
+	const char *usage;
+	// returns 0 on success
+	int (*open)(const char *argument);
+	// blocks until the next value of the device is available
+	// returns 0 on success, 1 if the device has no more values and -1 on errors or interruption
+	int (*read)(double *watts);
+	void (*close)(void);
+};
+
+// set on SIGINT or SIGTERM, devices waiting for a changed value have to check it before sleeping again
+extern volatile sig_atomic_t stop_requested;
+
+extern const struct power_device smartpower_device;
+extern const struct power_device replay_device;
+extern const struct power_device command_device;
+extern const struct power_device smartdroid_device;
+extern const struct power_device sensor_device;
+
+#endif
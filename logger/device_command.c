@@ -0,0 +1,50 @@
+#include "device.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// Any measuring device with a tool that keeps running and prints one power value in Watt per line.
+
+static FILE *output;
+
+static int command_open(const char *argument)
+{
+	if (!argument)
+	{
+		fprintf(stderr, "The command device needs a command.\n");
+		return 1;
+	}
+	output = popen(argument, "r");
+	if (!output)
+	{
+		perror(argument);
+		return 1;
+	}
+	return 0;
+}
+
+static int command_read(double *watts)
+{
+	char line[256];
+	char *end;
+
+	while (fgets(line, sizeof(line), output))
+	{
+		*watts = strtod(line, &end);
+		if (end != line)
+			return 0;
+	}
+	return ferror(output) ? -1 : 1;
+}
+
+static void command_close(void)
+{
+	pclose(output);
+}
+
+const struct power_device command_device = {
+    .name = "command",
+    .usage = "command:<command>              Run a command printing one value in Watt per line",
+    .open = command_open,
+    .read = command_read,
+    .close = command_close};
@@ -0,0 +1,69 @@
+#include "device.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Replays a power log in the format of output/power_log.csv ('time,power' in seconds and Watt),
+// keeping the time between the values, so the logger can be tested without a measuring device.
+
+static FILE *file;
+static struct timespec replay_start;
+static double first_time = -1;
+
+static int replay_open(const char *argument)
+{
+	if (!argument)
+	{
+		fprintf(stderr, "The replay device needs a file.\n");
+		return 1;
+	}
+	file = fopen(argument, "r");
+	if (!file)
+	{
+		perror(argument);
+		return 1;
+	}
+	return 0;
+}
+
+static int replay_read(double *watts)
+{
+	char line[256];
+	struct timespec due;
+	double time;
+	long long ns;
+
+	while (1)
+	{
+		if (!fgets(line, sizeof(line), file))
+			return 1;
+		// the header and malformed lines are skipped
+		if (sscanf(line, "%lf,%lf", &time, watts) == 2)
+			break;
+	}
+	if (first_time < 0)
+	{
+		first_time = time;
+		clock_gettime(CLOCK_MONOTONIC, &replay_start);
+	}
+
+	ns = replay_start.tv_nsec + (long long)((time - first_time) * 1000000000);
+	due.tv_sec = replay_start.tv_sec + ns / 1000000000;
+	due.tv_nsec = ns % 1000000000;
+	if (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL))
+		return -1;
+	return 0;
+}
+
+static void replay_close(void)
+{
+	fclose(file);
+}
+
+const struct power_device replay_device = {
+    .name = "replay",
+    .usage = "replay:<csv file>               Replay a power log with its original timing",
+    .open = replay_open,
+    .read = replay_read,
+    .close = replay_close};
@@ -0,0 +1,165 @@
+#include "device.h"
+
+#include <fcntl.h>
+#include <libgen.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Power and energy sensors of the hwmon and IIO subsystems, read from their sysfs file:
+//   hwmon power*_input, power*_average  microwatts
+//   hwmon energy*_input                 microjoules, the power is calculated between changes
+//   IIO in_power*_input                 milliwatts
+//   IIO in_power*_raw                   scaled to milliwatts by in_power*_scale or in_power_scale
+// The file is polled at a fixed interval and every changed value is returned.
+
+#define DEFAULT_INTERVAL_MS (10)
+
+static int fd = -1;
+static double scale;
+static int is_energy;
+static long interval_ms = DEFAULT_INTERVAL_MS;
+static struct timespec next_poll;
+static double last_value;
+static struct timespec last_change;
+static int has_value;
+
+static int read_number(int file, double *value)
+{
+	char buffer[64];
+	ssize_t len;
+
+	len = pread(file, buffer, sizeof(buffer) - 1, 0);
+	if (len <= 0)
+		return 1;
+	buffer[len] = '\0';
+	*value = strtod(buffer, NULL);
+	return 0;
+}
+
+// scale of a raw IIO value, a channel specific scale takes precedence over the shared one
+static int read_iio_scale(const char *path, const char *name)
+{
+	char scale_path[600];
+	char directory[512];
+	int file;
+	int err;
+
+	snprintf(directory, sizeof(directory), "%s", path);
+	snprintf(scale_path, sizeof(scale_path), "%s/%.*sscale", dirname(directory), (int)(strlen(name) - strlen("raw")), name);
+	file = open(scale_path, O_RDONLY);
+	if (file < 0)
+	{
+		snprintf(directory, sizeof(directory), "%s", path);
+		snprintf(scale_path, sizeof(scale_path), "%s/in_power_scale", dirname(directory));
+		file = open(scale_path, O_RDONLY);
+	}
+	if (file < 0)
+		return 1;
+	err = read_number(file, &scale);
+	close(file);
+	// milliwatts to Watt
+	scale /= 1000;
+	return err;
+}
+
+static int sensor_open(const char *argument)
+{
+	char path[512];
+	char base[512];
+	char *separator;
+	const char *name;
+
+	if (!argument)
+	{
+		fprintf(stderr, "The sensor device needs the sysfs file of the sensor.\n");
+		return 1;
+	}
+	snprintf(path, sizeof(path), "%s", argument);
+	separator = strchr(path, ',');
+	if (separator)
+	{
+		*separator = '\0';
+		interval_ms = strtol(separator + 1, NULL, 0);
+	}
+	snprintf(base, sizeof(base), "%s", path);
+	name = basename(base);
+
+	if (strncmp(name, "in_power", 8) == 0 && strstr(name, "_raw"))
+	{
+		if (read_iio_scale(path, name))
+		{
+			fprintf(stderr, "No scale found for %s.\n", path);
+			return 1;
+		}
+	}
+	else if (strncmp(name, "in_power", 8) == 0)
+		scale = 0.001;
+	else if (strncmp(name, "energy", 6) == 0)
+	{
+		scale = 0.000001;
+		is_energy = 1;
+	}
+	else if (strncmp(name, "power", 5) == 0)
+		scale = 0.000001;
+	else
+	{
+		fprintf(stderr, "Unknown sensor file %s.\n", path);
+		return 1;
+	}
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+	{
+		perror(path);
+		return 1;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &next_poll);
+	return 0;
+}
+
+static int sensor_read(double *watts)
+{
+	struct timespec now;
+	double value, seconds;
+
+	while (1)
+	{
+		if (read_number(fd, &value))
+		{
+			perror("Reading the sensor failed");
+			return -1;
+		}
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		if (!has_value || value != last_value)
+		{
+			seconds = (now.tv_sec - last_change.tv_sec) + (now.tv_nsec - last_change.tv_nsec) / 1e9;
+			*watts = is_energy ? (value - last_value) * scale / seconds : value * scale;
+			last_value = value;
+			last_change = now;
+			// an energy value only gives a power together with the previous one
+			if (has_value++ || !is_energy)
+				return 0;
+		}
+
+		next_poll.tv_nsec += interval_ms * 1000000;
+		next_poll.tv_sec += next_poll.tv_nsec / 1000000000;
+		next_poll.tv_nsec %= 1000000000;
+		if (stop_requested || clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next_poll, NULL))
+			return -1;
+	}
+}
+
+static void sensor_close(void)
+{
+	close(fd);
+}
+
+const struct power_device sensor_device = {
+    .name = "sensor",
+    .usage = "sensor:<sysfs file>[,<ms>]     hwmon or IIO power or energy sensor, polled every 10 ms by default",
+    .open = sensor_open,
+    .read = sensor_read,
+    .close = sensor_close};
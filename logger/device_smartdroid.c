@@ -0,0 +1,62 @@
+#include "device.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// The smartdroid tool reads a single value from the ODROID Smart Power per call.
+// Prefer the smartpower device, this one is kept for setups where only the tool works.
+
+#define POLL_INTERVAL_NS (1000000)
+
+static char command[300];
+static double last_watts = -1;
+
+static int smartdroid_open(const char *argument)
+{
+	const char *path = argument ? argument : getenv("SMARTDROID_PATH");
+
+	snprintf(command, sizeof(command), "%s -m power", path ? path : "./smartdroid");
+	return 0;
+}
+
+static int smartdroid_read(double *watts)
+{
+	const struct timespec interval = {.tv_sec = 0, .tv_nsec = POLL_INTERVAL_NS};
+	FILE *output;
+	int values;
+
+	while (1)
+	{
+		output = popen(command, "r");
+		if (!output)
+		{
+			perror(command);
+			return -1;
+		}
+		values = fscanf(output, "%lf", watts);
+		if (pclose(output) || values != 1)
+		{
+			fprintf(stderr, "'%s' failed.\n", command);
+			return -1;
+		}
+		// the device answers with its last value until its next sampling period
+		if (*watts != last_watts)
+			break;
+		if (stop_requested || nanosleep(&interval, NULL))
+			return -1;
+	}
+	last_watts = *watts;
+	return 0;
+}
+
+static void smartdroid_close(void)
+{
+}
+
+const struct power_device smartdroid_device = {
+    .name = "smartdroid",
+    .usage = "smartdroid[:<path>]            ODROID Smart Power through the smartdroid tool, by default at SMARTDROID_PATH",
+    .open = smartdroid_open,
+    .read = smartdroid_read,
+    .close = smartdroid_close};
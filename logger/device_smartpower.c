@@ -0,0 +1,156 @@
+#include "device.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// The ODROID Smart Power is a HID device answering requests with a line of text like '5.123V 0.456A 2.345W 0.012Wh'.
+// It answers with its last value until the next sampling period of the device, so it is polled until the value changes.
+
+#define SMARTPOWER_HID_ID "000004D8:0000003F"
+#define REQUEST_DATA (0x37)
+#define REPORT_SIZE (64)
+#define POLL_INTERVAL_NS (200000)
+
+static int fd = -1;
+static double last_watts = -1;
+
+// the first hidraw device with the vendor and product ID of the Smart Power
+static int find_device(char *path, size_t len)
+{
+	char uevent_path[300];
+	char line[256];
+	struct dirent *entry;
+	DIR *dir;
+	FILE *uevent;
+	int found = 0;
+
+	dir = opendir("/sys/class/hidraw");
+	if (!dir)
+		return 0;
+	while (!found && (entry = readdir(dir)))
+	{
+		if (entry->d_name[0] == '.')
+			continue;
+		snprintf(uevent_path, sizeof(uevent_path), "/sys/class/hidraw/%s/device/uevent", entry->d_name);
+		uevent = fopen(uevent_path, "r");
+		if (!uevent)
+			continue;
+		while (fgets(line, sizeof(line), uevent))
+		{
+			if (strncmp(line, "HID_ID=", 7) == 0 && strstr(line, SMARTPOWER_HID_ID))
+			{
+				snprintf(path, len, "/dev/%s", entry->d_name);
+				found = 1;
+				break;
+			}
+		}
+		fclose(uevent);
+	}
+	closedir(dir);
+	return found;
+}
+
+static int smartpower_open(const char *argument)
+{
+	char path[300];
+
+	if (argument)
+		snprintf(path, sizeof(path), "%s", argument);
+	else if (!find_device(path, sizeof(path)))
+	{
+		fprintf(stderr, "No ODROID Smart Power found, please give the hidraw device.\n");
+		return 1;
+	}
+
+	fd = open(path, O_RDWR);
+	if (fd < 0)
+	{
+		perror(path);
+		return 1;
+	}
+	return 0;
+}
+
+// the power is the value with the unit 'W', as opposed to the energy in 'Wh'
+static int parse_watts(const char *text, double *watts)
+{
+	char *end;
+	double value;
+
+	while (*text)
+	{
+		value = strtod(text, &end);
+		if (end == text)
+		{
+			++text;
+			continue;
+		}
+		if (end[0] == 'W' && end[1] != 'h')
+		{
+			*watts = value;
+			return 0;
+		}
+		text = end;
+	}
+	return 1;
+}
+
+static int request_watts(double *watts)
+{
+	// the first byte is the report number, 0 for devices without numbered reports
+	unsigned char request[REPORT_SIZE + 1] = {0, REQUEST_DATA};
+	char report[REPORT_SIZE + 1];
+	ssize_t len;
+
+	if (write(fd, request, sizeof(request)) < 0)
+		return -1;
+	len = read(fd, report, REPORT_SIZE);
+	if (len < 2)
+		return -1;
+	report[len] = '\0';
+
+	if (report[0] != REQUEST_DATA || parse_watts(report + 2, watts))
+		return 1;
+	return 0;
+}
+
+static int smartpower_read(double *watts)
+{
+	const struct timespec interval = {.tv_sec = 0, .tv_nsec = POLL_INTERVAL_NS};
+	int err;
+
+	while (1)
+	{
+		err = request_watts(watts);
+		if (err < 0)
+		{
+			if (errno != EINTR)
+				perror("Reading the Smart Power failed");
+			return -1;
+		}
+		if (err == 0 && *watts != last_watts)
+			break;
+		if (stop_requested || nanosleep(&interval, NULL))
+			return -1;
+	}
+	last_watts = *watts;
+	return 0;
+}
+
+static void smartpower_close(void)
+{
+	close(fd);
+}
+
+const struct power_device smartpower_device = {
+    .name = "smartpower",
+    .usage = "smartpower[:<hidraw device>]  ODROID Smart Power, found automatically by default",
+    .open = smartpower_open,
+    .read = smartpower_read,
+    .close = smartpower_close};
@@ -0,0 +1,122 @@
+#include "device.h"
+#include "ring.h"
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Power logging daemon: keeps the measuring device open and writes every new value with a CLOCK_MONOTONIC_RAW timestamp
+// into a ring file, until it receives SIGINT or SIGTERM or the device has no more values.
+
+#define DEFAULT_CAPACITY (1 << 22)
+
+static const struct power_device *devices[] = {&smartpower_device, &smartdroid_device, &sensor_device, &command_device, &replay_device};
+
+volatile sig_atomic_t stop_requested;
+
+static void stop_handler(int signal)
+{
+	stop_requested = 1;
+}
+
+static void help(const char *name)
+{
+	unsigned i;
+
+	fprintf(stderr, "Syntax: %s [-d <device>] [-n <records>] <log file>\n", name);
+	fprintf(stderr, "    -d: The measuring device, 'smartpower' by default, one of\n");
+	for (i = 0; i < sizeof(devices) / sizeof(devices[0]); ++i)
+		fprintf(stderr, "        %s\n", devices[i]->usage);
+	fprintf(stderr, "    -n: Number of values kept in the log file before the oldest are overwritten, default %u\n", DEFAULT_CAPACITY);
+}
+
+// '<name>[:<argument>]'
+static const struct power_device *select_device(char *spec, const char **argument)
+{
+	char *separator = strchr(spec, ':');
+	unsigned i;
+
+	*argument = NULL;
+	if (separator)
+	{
+		*separator = '\0';
+		*argument = separator + 1;
+	}
+	for (i = 0; i < sizeof(devices) / sizeof(devices[0]); ++i)
+	{
+		if (strcmp(devices[i]->name, spec) == 0)
+			return devices[i];
+	}
+	fprintf(stderr, "Device '%s' unknown.\n", spec);
+	return NULL;
+}
+
+static int64_t timestamp(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC_RAW, &now);
+	return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+int main(int argc, char **argv)
+{
+	char default_device[] = "smartpower";
+	char *device_spec = default_device;
+	const struct power_device *device;
+	const char *argument;
+	unsigned long long capacity = DEFAULT_CAPACITY;
+	struct sigaction action = {.sa_handler = stop_handler};
+	double watts;
+	int option, err = 0;
+
+	while ((option = getopt(argc, argv, "d:n:h")) != -1)
+	{
+		switch (option)
+		{
+		case 'd':
+			device_spec = optarg;
+			break;
+		case 'n':
+			capacity = strtoull(optarg, NULL, 0);
+			break;
+		default:
+			help(argv[0]);
+			return option == 'h' ? 0 : 1;
+		}
+	}
+	if (optind != argc - 1 || capacity == 0)
+	{
+		help(argv[0]);
+		return 1;
+	}
+
+	device = select_device(device_spec, &argument);
+	if (!device || device->open(argument))
+		return 1;
+	if (ring_open(argv[optind], capacity))
+	{
+		device->close();
+		return 1;
+	}
+
+	// without SA_RESTART, a blocking read of the device returns on the signal
+	sigaction(SIGINT, &action, NULL);
+	sigaction(SIGTERM, &action, NULL);
+
+	while (!stop_requested)
+	{
+		err = device->read(&watts);
+		if (err)
+			break;
+		ring_append(timestamp(), watts);
+	}
+
+	ring_close();
+	device->close();
+
+	return err < 0 && !stop_requested;
+}
@@ -0,0 +1,63 @@
+#include "ring.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static struct ring_header *header;
+static struct ring_record *records;
+static size_t mapped_size;
+
+int ring_open(const char *path, uint64_t capacity)
+{
+	int fd;
+
+	fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+	{
+		perror("Could not create the log file");
+		return 1;
+	}
+
+	mapped_size = sizeof(struct ring_header) + capacity * sizeof(struct ring_record);
+	if (ftruncate(fd, mapped_size))
+	{
+		perror("Could not allocate the log file");
+		close(fd);
+		return 1;
+	}
+
+	header = mmap(NULL, mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (header == MAP_FAILED)
+	{
+		perror("Could not map the log file");
+		return 1;
+	}
+	records = (struct ring_record *)(header + 1);
+
+	memcpy(header->magic, RING_MAGIC, sizeof(header->magic));
+	header->version = RING_VERSION;
+	header->record_size = sizeof(struct ring_record);
+	header->capacity = capacity;
+	header->count = 0;
+
+	return 0;
+}
+
+void ring_append(int64_t time, double power)
+{
+	struct ring_record *record = &records[header->count % header->capacity];
+
+	record->time = time;
+	record->power = power;
+	__atomic_store_n(&header->count, header->count + 1, __ATOMIC_RELEASE);
+}
+
+void ring_close(void)
+{
+	msync(header, mapped_size, MS_SYNC);
+	munmap(header, mapped_size);
+}
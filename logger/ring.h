@@ -0,0 +1,33 @@
+#ifndef RING_H
+#define RING_H
+
+#include <stdint.h>
+
+// The log is a file with a header followed by a fixed number of records, overwriting the oldest ones when full.
+// 'count' is the total number of records ever written, it is only increased after a record is complete,
+// so the file can be read while the logger is still running.
+
+#define RING_MAGIC "PWRRING1"
+#define RING_VERSION (1)
+
+struct ring_header
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t record_size;
+	uint64_t capacity;
+	uint64_t count;
+};
+
+struct ring_record
+{
+	// CLOCK_MONOTONIC_RAW in nanoseconds
+	int64_t time;
+	double power;
+};
+
+int ring_open(const char *path, uint64_t capacity);
+void ring_append(int64_t time, double power);
+void ring_close(void);
+
+#endif
@@ -5,23 +5,59 @@ help() {
     echo "### Measure script ###"
     echo "######################"
     echo
-    echo "Syntax: measure.sh [-e|h] <ip> <duration>"
+    echo "Syntax: measure.sh [-e|m <meter>|g <code>|I <seconds>|b|H|L|R <trace>|W <sizes>|F <rates>|C <limits>|D <settings>|P <policies>|p|n <count>|r <rounds>|S <seed>|c <cpus>|t <timer>|T <temperature>|h] <ip> <duration>"
     echo "Description:"
     echo "    <ip>: The IP address of the measurebox"
     echo "    <duration>: Duration of a single measurement in milliseconds."
     echo "                Should depend mainly on temporal resolution of power measurement method."
     echo
     echo "    -e: Run external power logging simultaneous to measurement"
+    echo "    -m: Measuring device for external power logging, e.g. 'sensor:<sysfs file>' (see logger/powerlog -h), the ODROID Smart Power by default"
+    echo "    -I: Repeat the synchronization pattern in between the measurements after this many seconds (default 300)"
+    echo "    -g: Code of the synchronization pattern for external power logging, 'barker' (default), 'prbs<order>' (e.g. prbs6) or 'square'"
+    echo "    -b: Benchmark the overhead of the measurement harness itself before measuring"
+    echo "    -H: Also measure all MWAIT hints the CPU enumerates, including the ones the idle driver does not use (x86)"
+    echo "    -L: Also measure every idle state with half the window length and recommend cpuidle latencies and target residencies"
+    echo "    -R: Also measure while replaying this idle trace, as written by scripts/convertIdleTrace.py"
+    echo "    -W: Also measure how long refilling the caches takes after waking up from every idle state, for these working set sizes in KiB (e.g. 32,1024,32768)"
+    echo "    -F: Also measure the energy per wakeup of every MWAIT state at these wakeup rates per second (e.g. 100,1000,10000), synchronized and staggered (x86)"
+    echo "    -C: Also measure every idle state with each of these Package C-state limits (e.g. 0,1,2,3,7) (Intel)"
+    echo "    -D: Also measure every idle state with each of these C-state auto-demotion settings (e.g. 0,3,15) (Intel)"
+    echo "    -P: Also measure the number of sleeping CPUs with each of these CPU selection policies (e.g. smt,llc,little)"
     echo "    -p: Deactivate Package C-states for measurement duration (Intel)"
+    echo "    -n: Number of measurements of each configuration (default 10, at most 100), the total is kept when they are split into rounds"
+    echo "    -r: Split the measurements of each configuration into this many rounds, interleaving all configurations in shuffled order"
+    echo "    -S: Seed for shuffling the configurations, by default a random one is used (recorded in the results either way)"
+    echo "    -c: Only measure the given CPUs (e.g. 0-7), the others keep running normally"
+    echo "    -t: Timer ending the measurements, 'HPET' (default) or 'TSC_DEADLINE' (x86)"
+    echo "    -T: Before each measurement, wait for the package to cool down to this temperature in degrees Celsius (Intel)"
     echo "    -h: Print help, then quit"
 }
 
 MEASUREBOX_OPTIONS=""
 
-while getopts "eph" option; do
+while getopts "em:g:I:bHLR:W:F:C:D:P:pn:r:S:c:t:T:h" option; do
     case $option in
     (e) EXTERNAL_MEASUREMENT=true;;
+    (m) export POWER_DEVICE=$OPTARG;;
+    (g) MEASUREBOX_OPTIONS="$MEASUREBOX_OPTIONS -g $OPTARG";;
+    (I) MEASUREBOX_OPTIONS="$MEASUREBOX_OPTIONS -I $OPTARG";;
+    (b) MEASUREBOX_OPTIONS="$MEASUREBOX_OPTIONS -b";;
+    (H) MEASUREBOX_OPTIONS="$MEASUREBOX_OPTIONS -H";;
+    (L) MEASUREBOX_OPTIONS="$MEASUREBOX_OPTIONS -L";;
+    (W) MEASUREBOX_OPTIONS="$MEASUREBOX_OPTIONS -W $OPTARG";;
+    (F) MEASUREBOX_OPTIONS="$MEASUREBOX_OPTIONS -F $OPTARG";;
+    (C) MEASUREBOX_OPTIONS="$MEASUREBOX_OPTIONS -C $OPTARG";;
+    (D) MEASUREBOX_OPTIONS="$MEASUREBOX_OPTIONS -D $OPTARG";;
+    (P) MEASUREBOX_OPTIONS="$MEASUREBOX_OPTIONS -P $OPTARG";;
+    (R) REPLAY_TRACE=$(realpath "$OPTARG");;
     (p) MEASUREBOX_OPTIONS="$MEASUREBOX_OPTIONS -p";;
+    (n) MEASUREBOX_OPTIONS="$MEASUREBOX_OPTIONS -n $OPTARG";;
+    (r) MEASUREBOX_OPTIONS="$MEASUREBOX_OPTIONS -r $OPTARG";;
+    (S) MEASUREBOX_OPTIONS="$MEASUREBOX_OPTIONS -S $OPTARG";;
+    (c) MEASUREBOX_OPTIONS="$MEASUREBOX_OPTIONS -c $OPTARG";;
+    (t) MEASUREBOX_OPTIONS="$MEASUREBOX_OPTIONS -t $OPTARG";;
+    (T) MEASUREBOX_OPTIONS="$MEASUREBOX_OPTIONS -T $OPTARG";;
     (h) help; exit;;
     esac
 done
@@ -38,6 +74,12 @@ if [ "$EXTERNAL_MEASUREMENT" = true ]; then
     LOGGER_PID=$?
 fi
 
+# the idle trace has to be readable by the kernel module on the measurebox
+if [[ -n "$REPLAY_TRACE" ]]; then
+    scp "$REPLAY_TRACE" root@$1:/root/mwait_deploy/idle_trace.bin
+    MEASUREBOX_OPTIONS="$MEASUREBOX_OPTIONS -R /root/mwait_deploy/idle_trace.bin"
+fi
+
 # start the measurement script on the measurebox
 echo "mwait_deploy/measure.sh $MEASUREBOX_OPTIONS $2" | ssh root@$1 'bash -s'
 
@@ -59,5 +101,8 @@ fi
 # post process
 scripts/postProcess.py
 scripts/plotMeasurements.py
+if [[ -f output/results/cpuidle_states ]]; then
+    scripts/recommendCpuidle.py
+fi
 
 popd
@@ -0,0 +1,60 @@
+#include "energy.h"
+
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/err.h>
+#include <linux/string.h>
+
+// ARM has no architectural equivalent to RAPL, so energy values are taken from a sensor the kernel already exposes.
+// This is usually a hwmon 'energyX_input' file, which is also how SCMI energy counters are made available (scmi-hwmon).
+// Unit of these files is microJoule.
+// The file is read like from userspace because there is no in-kernel interface to it: hwmon only exports registration
+// to drivers, not reading the attributes of another one, and the SCMI sensor operations are only handed to SCMI drivers
+// bound to the firmware. The read goes through the driver's show callback, which may sleep for a firmware round trip,
+// so it is sampled around the measurement, see prepare_before_each_measurement().
+static struct file *energy_file;
+
+int open_energy_source(const char *path)
+{
+	energy_file = filp_open(path, O_RDONLY, 0);
+	if (IS_ERR(energy_file))
+	{
+		printk(KERN_ERR "Could not open energy source '%s' (%ld)!\n", path, PTR_ERR(energy_file));
+		energy_file = NULL;
+		return 1;
+	}
+
+	return 0;
+}
+
+void close_energy_source(void)
+{
+	if (energy_file)
+	{
+		filp_close(energy_file, NULL);
+		energy_file = NULL;
+	}
+}
+
+bool energy_source_available(void)
+{
+	return energy_file != NULL;
+}
+
+// May sleep, must not be called with interrupts disabled
+int read_energy_source(u64 *microjoules)
+{
+	char buf[32];
+	loff_t pos = 0; // sysfs regenerates the value on every read from offset 0
+	ssize_t len;
+
+	len = kernel_read(energy_file, buf, sizeof(buf) - 1, &pos);
+	if (len <= 0)
+	{
+		printk(KERN_WARNING "WARNING: Failed to read energy source.\n");
+		return 1;
+	}
+	buf[len] = '\0';
+
+	return kstrtou64(strim(buf), 10, microjoules);
+}
@@ -0,0 +1,11 @@
+#ifndef ENERGY_H
+#define ENERGY_H
+
+#include <linux/types.h>
+
+int open_energy_source(const char *path);
+void close_energy_source(void);
+bool energy_source_available(void);
+int read_energy_source(u64 *microjoules);
+
+#endif
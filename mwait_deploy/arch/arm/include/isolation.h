@@ -0,0 +1,11 @@
+#ifndef ISOLATION_H
+#define ISOLATION_H
+
+#include <linux/cpumask.h>
+
+int isolate_interrupts(const struct cpumask *measured_cpus);
+void restore_interrupts(void);
+void disable_percpu_interrupts_local(void);
+void enable_percpu_interrupts_local(void);
+
+#endif
@@ -5,7 +5,8 @@ enum entry_mechanism
 {
 	ENTRY_MECHANISM_UNKNOWN,
 	ENTRY_MECHANISM_POLL,
-	ENTRY_MECHANISM_WFI
+	ENTRY_MECHANISM_WFI,
+	ENTRY_MECHANISM_PSCI
 };
 
 #include "generic/measure.h"
@@ -7,6 +7,8 @@
 
 struct pkg_attributes
 {
+	u64 energy_consumption[MAX_NUMBER_OF_MEASUREMENTS];
+	u64 energy_duration[MAX_NUMBER_OF_MEASUREMENTS];
 };
 
 struct cpu_attributes
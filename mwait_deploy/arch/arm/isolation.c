@@ -0,0 +1,162 @@
+#include "isolation.h"
+
+#include <linux/kernel.h>
+#include <linux/irq.h>
+#include <linux/interrupt.h>
+#include <linux/irqdesc.h>
+#include <linux/slab.h>
+
+// GIC PPIs of the timer programmed through CNTP_CVAL_EL0
+// Depending on whether the kernel runs in EL2 (VHE) or not, this is the hypervisor or the non-secure physical timer
+#define HWIRQ_HYP_TIMER (26)
+#define HWIRQ_PHYS_TIMER (30)
+
+struct isolated_irq
+{
+	unsigned int irq;
+	bool redirected;
+	cpumask_var_t affinity_backup;
+};
+
+static struct isolated_irq *isolated_irqs;
+static unsigned isolated_irq_count;
+static unsigned int *percpu_irqs;
+static unsigned percpu_irq_count;
+static bool *percpu_irq_was_enabled; // nr_cpu_ids rows of percpu_irq_count entries
+
+static bool is_wakeup_timer(struct irq_data *data)
+{
+	return data->hwirq == HWIRQ_HYP_TIMER || data->hwirq == HWIRQ_PHYS_TIMER;
+}
+
+static void isolate_shared_irq(unsigned int irq, struct irq_data *data, const struct cpumask *housekeeping_cpus)
+{
+	struct isolated_irq *entry = &isolated_irqs[isolated_irq_count++];
+
+	entry->irq = irq;
+	entry->redirected = false;
+
+	// move the interrupt to the housekeeping CPUs if possible, so they keep working normally
+	if (!cpumask_empty(housekeeping_cpus) && !irqd_affinity_is_managed(data) &&
+	    alloc_cpumask_var(&entry->affinity_backup, GFP_KERNEL))
+	{
+		cpumask_copy(entry->affinity_backup, irq_data_get_affinity_mask(data));
+		if (!irq_set_affinity(irq, housekeeping_cpus))
+		{
+			entry->redirected = true;
+			return;
+		}
+		free_cpumask_var(entry->affinity_backup);
+	}
+
+	irq_set_status_flags(irq, IRQ_DISABLE_UNLAZY);
+	disable_irq(irq);
+}
+
+// Only interrupts that actually exist and have a handler are touched
+int isolate_interrupts(const struct cpumask *measured_cpus)
+{
+	cpumask_var_t housekeeping_cpus;
+	unsigned redirected = 0;
+
+	if (!zalloc_cpumask_var(&housekeeping_cpus, GFP_KERNEL))
+		return 1;
+	cpumask_andnot(housekeeping_cpus, cpu_online_mask, measured_cpus);
+
+	isolated_irqs = kcalloc(nr_irqs, sizeof(*isolated_irqs), GFP_KERNEL);
+	percpu_irqs = kcalloc(nr_irqs, sizeof(*percpu_irqs), GFP_KERNEL);
+	if (!isolated_irqs || !percpu_irqs)
+	{
+		kfree(isolated_irqs);
+		kfree(percpu_irqs);
+		isolated_irqs = NULL;
+		percpu_irqs = NULL;
+		free_cpumask_var(housekeeping_cpus);
+		return 1;
+	}
+
+	for (unsigned int irq = 0; irq < nr_irqs; ++irq)
+	{
+		struct irq_data *data = irq_get_irq_data(irq);
+
+		if (!data || !irq_has_action(irq))
+			continue;
+
+		if (irqd_is_per_cpu(data))
+		{
+			if (!is_wakeup_timer(data))
+				percpu_irqs[percpu_irq_count++] = irq;
+			continue;
+		}
+
+		isolate_shared_irq(irq, data, housekeeping_cpus);
+	}
+
+	percpu_irq_was_enabled = kcalloc(nr_cpu_ids * max(percpu_irq_count, 1u), sizeof(*percpu_irq_was_enabled), GFP_KERNEL);
+	if (!percpu_irq_was_enabled)
+		percpu_irq_count = 0;
+
+	for (unsigned i = 0; i < isolated_irq_count; ++i)
+		redirected += isolated_irqs[i].redirected;
+
+	printk(KERN_INFO "Isolated %u interrupts (%u redirected to housekeeping CPUs), masking %u per-CPU interrupts.\n",
+	       isolated_irq_count, redirected, percpu_irq_count);
+
+	free_cpumask_var(housekeeping_cpus);
+	return 0;
+}
+
+void restore_interrupts(void)
+{
+	if (!isolated_irqs)
+		return;
+
+	for (unsigned i = 0; i < isolated_irq_count; ++i)
+	{
+		struct isolated_irq *entry = &isolated_irqs[i];
+
+		if (entry->redirected)
+		{
+			irq_set_affinity(entry->irq, entry->affinity_backup);
+			free_cpumask_var(entry->affinity_backup);
+		}
+		else
+		{
+			enable_irq(entry->irq);
+			irq_clear_status_flags(entry->irq, IRQ_DISABLE_UNLAZY);
+		}
+	}
+
+	kfree(isolated_irqs);
+	kfree(percpu_irqs);
+	kfree(percpu_irq_was_enabled);
+	isolated_irqs = NULL;
+	percpu_irqs = NULL;
+	percpu_irq_was_enabled = NULL;
+	isolated_irq_count = 0;
+	percpu_irq_count = 0;
+}
+
+// Per-CPU interrupts are only re-enabled if they were enabled on this CPU before
+void disable_percpu_interrupts_local(void)
+{
+	bool *was_enabled = &percpu_irq_was_enabled[smp_processor_id() * percpu_irq_count];
+
+	for (unsigned i = 0; i < percpu_irq_count; ++i)
+	{
+		was_enabled[i] = irq_percpu_is_enabled(percpu_irqs[i]);
+		if (was_enabled[i])
+			disable_percpu_irq(percpu_irqs[i]);
+	}
+}
+
+void enable_percpu_interrupts_local(void)
+{
+	bool *was_enabled = &percpu_irq_was_enabled[smp_processor_id() * percpu_irq_count];
+
+	for (unsigned i = 0; i < percpu_irq_count; ++i)
+	{
+		if (was_enabled[i])
+			enable_percpu_irq(percpu_irqs[i], IRQ_TYPE_NONE);
+	}
+}
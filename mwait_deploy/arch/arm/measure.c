@@ -1,12 +1,32 @@
 #include "measure.h"
 #include "sysfs.h"
+#include "energy.h"
+#include "isolation.h"
 
 #include <linux/moduleparam.h>
+#include <linux/cacheinfo.h>
 #include <linux/interrupt.h>
+#include <linux/kernel_stat.h>
+#include <linux/sched/clock.h>
+#include <linux/sched/topology.h>
+#include <linux/arm-smccc.h>
+#include <uapi/linux/psci.h>
 
 static char *entry_mechanism = "WFI";
 module_param(entry_mechanism, charp, 0);
-MODULE_PARM_DESC(entry_mechanism, "The mechanism used to enter the idle state. Supported are 'WFI' and 'POLL'. Default is 'WFI'.");
+MODULE_PARM_DESC(entry_mechanism, "The mechanism used to enter the idle state. Supported are 'WFI', 'PSCI' and 'POLL'. Default is 'WFI'.");
+static char *psci_state = NULL;
+module_param(psci_state, charp, 0);
+MODULE_PARM_DESC(psci_state, "If entry_mechanism is 'PSCI', this is the power_state parameter passed to PSCI CPU_SUSPEND.\n"
+			     "Only standby (retention) states are supported, as power down states would require saving the CPU context.");
+static char *energy_source = NULL;
+module_param(energy_source, charp, 0);
+MODULE_PARM_DESC(energy_source, "Path of a file providing an accumulated energy value in microJoule, e.g. a hwmon 'energy1_input' (also used for SCMI energy counters).\n"
+				"If not given, no energy values are collected.");
+
+static u32 calculated_psci_state;
+static u64 start_energy, final_energy, energy_consumption;
+static u64 start_energy_time, final_energy_time, energy_duration;
 
 DEFINE_PER_CPU(u64, start_sc);
 DEFINE_PER_CPU(u64, end_sc);
@@ -80,6 +100,14 @@ void set_cpu_final_values(int this_cpu)
 {
 }
 
+static inline void psci_cpu_suspend(void)
+{
+	struct arm_smccc_res res;
+
+	// returns normally for standby states, both on wakeup and if the firmware denies entering the state
+	arm_smccc_1_1_invoke(PSCI_0_2_FN64_CPU_SUSPEND, calculated_psci_state, 0, 0, &res);
+}
+
 void do_system_specific_sleep(int this_cpu)
 {
 	// handle POLL separately to make measured workload as simple as possible
@@ -105,6 +133,10 @@ void do_system_specific_sleep(int this_cpu)
 			asm volatile("wfi" ::: "memory");
 			break;
 
+		case ENTRY_MECHANISM_PSCI:
+			psci_cpu_suspend();
+			break;
+
 		case ENTRY_MECHANISM_POLL:
 		case ENTRY_MECHANISM_UNKNOWN:
 			break;
@@ -114,6 +146,15 @@ void do_system_specific_sleep(int this_cpu)
 
 void evaluate_global(void)
 {
+	if (!energy_source_available())
+		return;
+
+	final_energy_time = local_clock();
+	if (read_energy_source(&final_energy))
+		redo_measurement = true;
+
+	energy_consumption = (final_energy - start_energy) * 10; // microJoule to 0.1 microJoule, like x86 RAPL values
+	energy_duration = final_energy_time - start_energy_time;
 }
 
 void evaluate_cpu(int this_cpu)
@@ -121,8 +162,16 @@ void evaluate_cpu(int this_cpu)
 	per_cpu(wakeup_time, this_cpu) = ((per_cpu(final_sc, this_cpu) - per_cpu(end_sc, this_cpu)) * 1000000000) / sc_frequency;
 }
 
+// The energy source can only be read with interrupts enabled, so it is sampled around the measurement instead of inside it.
+// The time between both samples is published as well, so the small overhead can be accounted for when calculating power.
 void prepare_before_each_measurement(void)
 {
+	if (!energy_source_available())
+		return;
+
+	if (read_energy_source(&start_energy))
+		redo_measurement = true;
+	start_energy_time = local_clock();
 }
 
 void cleanup_after_each_measurement(void)
@@ -131,9 +180,8 @@ void cleanup_after_each_measurement(void)
 
 inline void commit_system_specific_results(unsigned number)
 {
-	for (unsigned i = 0; i < cpus_present; ++i)
-	{
-	}
+	pkg_stats.attributes.energy_consumption[number] = energy_consumption;
+	pkg_stats.attributes.energy_duration[number] = energy_duration;
 }
 
 void preliminary_checks(void)
@@ -142,24 +190,12 @@ void preliminary_checks(void)
 
 void disable_percpu_interrupts(int this_cpu)
 {
-	for (int i = 0; i <= 31; ++i)
-	{
-		if (i != 13)
-		{
-			disable_percpu_irq(i);
-		}
-	}
+	disable_percpu_interrupts_local();
 }
 
 void enable_percpu_interrupts(int this_cpu)
 {
-	for (int i = 0; i <= 31; ++i)
-	{
-		if (i != 13)
-		{
-			enable_percpu_irq(i, IRQ_TYPE_NONE);
-		}
-	}
+	enable_percpu_interrupts_local();
 }
 
 inline enum entry_mechanism get_signal_low_mechanism(void)
@@ -167,19 +203,119 @@ inline enum entry_mechanism get_signal_low_mechanism(void)
 	return ENTRY_MECHANISM_WFI;
 }
 
+// every CPU ends its window with its own timer, which would have to be shared with the replayed idle periods
+int prepare_replay(void)
+{
+	printk(KERN_ERR "Timed idle periods ('replay' and 'periodic' mode) are not supported on ARM, aborting!\n");
+	return 1;
+}
+
+u64 get_entry_hint(int cpu)
+{
+	return 0;
+}
+
+// all CPUs use the same mechanism, PSCI power states of other clusters are measured by selecting their CPUs with cpu_selection
+enum entry_mechanism get_requested_entry_mechanism(int cpu)
+{
+	return requested_entry_mechanism;
+}
+
+// big.LITTLE has no architectural core type, the capacity the firmware describes tells them apart
+enum core_type get_core_type(int cpu)
+{
+	unsigned long capacity = arch_scale_cpu_capacity(cpu);
+	unsigned long max_capacity = 0;
+	unsigned long min_capacity = ULONG_MAX;
+	unsigned other;
+
+	for_each_cpu(other, cpu_online_mask)
+	{
+		max_capacity = max(max_capacity, arch_scale_cpu_capacity(other));
+		min_capacity = min(min_capacity, arch_scale_cpu_capacity(other));
+	}
+	if (max_capacity == min_capacity)
+		return CORE_TYPE_UNKNOWN;
+	return capacity == max_capacity ? CORE_TYPE_PERFORMANCE : CORE_TYPE_EFFICIENCY;
+}
+
+bool is_measurement_ongoing(void)
+{
+	return false;
+}
+
+void do_system_specific_idle(int this_cpu, enum entry_mechanism mechanism, u64 hint, u64 idle_ns)
+{
+}
+
+// PSCI power states are not enumerated by the hardware, measure.sh takes them from the device tree
+unsigned get_entry_hints(u64 *hints, unsigned max)
+{
+	return 0;
+}
+
+// the last cache level the kernel knows of, from the device tree or ACPI PPTT, e.g. the L3 of a DynamIQ cluster
+const struct cpumask *get_llc_cpumask(int cpu)
+{
+	struct cpu_cacheinfo *info = get_cpu_cacheinfo(cpu);
+
+	if (!info || !info->info_list || info->num_leaves == 0)
+		return cpumask_of(cpu);
+	return &info->info_list[info->num_leaves - 1].shared_cpu_map;
+}
+
+// Which CPUs an energy sensor covers is not known, so it has to be assumed to cover all of them
+const struct cpumask *get_package_counter_scope(int cpu)
+{
+	return cpu_online_mask;
+}
+
+static const char *package_level_counters[] = {"energy_consumption", NULL};
+
+const char **get_package_level_counters(void)
+{
+	return package_level_counters;
+}
+
+// includes IPIs and the per-CPU timer, as both are regular interrupts on ARM
+u64 get_interrupt_count(int cpu)
+{
+	return kstat_cpu_irqs_sum(cpu);
+}
+
+// pseudo-NMIs are not counted separately
+u64 get_nmi_count(int cpu)
+{
+	return 0;
+}
+
 int prepare(void)
 {
 	sc_frequency = read_sysreg(CNTFRQ_EL0) & 0xffffffff;
 
-	for (int i = 0; i <= 1024; ++i)
+	if (isolate_interrupts(&measured_cpus))
 	{
-		irq_set_status_flags(i, IRQ_DISABLE_UNLAZY);
-		disable_irq(i);
+		printk(KERN_ERR "Could not isolate interrupts, aborting!\n");
+		return 1;
 	}
 
 	return 0;
 }
 
+// Which bit marks a power down state depends on the format of the power_state parameter the firmware uses
+static bool psci_state_loses_context(u32 state)
+{
+	struct arm_smccc_res res;
+
+	arm_smccc_1_1_invoke(PSCI_1_0_FN_PSCI_FEATURES, PSCI_0_2_FN64_CPU_SUSPEND, &res);
+	if ((long)res.a0 >= 0 && (res.a0 & PSCI_1_0_FEATURES_CPU_SUSPEND_PF_MASK))
+	{
+		return state & PSCI_1_0_EXT_POWER_STATE_TYPE_MASK;
+	}
+
+	return state & PSCI_0_2_POWER_STATE_TYPE_MASK;
+}
+
 int prepare_measurements(void)
 {
 	printk(KERN_INFO "Using entry mechanism '%s'.", entry_mechanism);
@@ -191,6 +327,29 @@ int prepare_measurements(void)
 	{
 		requested_entry_mechanism = ENTRY_MECHANISM_WFI;
 	}
+	else if (strcmp(entry_mechanism, "PSCI") == 0)
+	{
+		requested_entry_mechanism = ENTRY_MECHANISM_PSCI;
+
+		if (!psci_state)
+		{
+			printk(KERN_ERR "No power state given in psci_state, despite using 'PSCI' entry mechanism. Aborting!\n");
+			return 1;
+		}
+
+		if (kstrtou32(psci_state, 0, &calculated_psci_state))
+		{
+			printk(KERN_ERR "Interpreting psci_state failed, aborting!\n");
+			return 1;
+		}
+
+		if (psci_state_loses_context(calculated_psci_state))
+		{
+			printk(KERN_ERR "PSCI power state 0x%x is a power down state, only standby states are supported. Aborting!\n", calculated_psci_state);
+			return 1;
+		}
+		printk(KERN_INFO "Using PSCI power state 0x%x.\n", calculated_psci_state);
+	}
 	else
 	{
 		requested_entry_mechanism = ENTRY_MECHANISM_UNKNOWN;
@@ -198,6 +357,9 @@ int prepare_measurements(void)
 		return 1;
 	}
 
+	if (energy_source && open_energy_source(energy_source))
+		return 1;
+
 	return 0;
 }
 
@@ -207,9 +369,6 @@ void cleanup_measurements(void)
 
 void cleanup(void)
 {
-	for (int i = 0; i <= 1024; ++i)
-	{
-		enable_irq(i);
-		irq_clear_status_flags(i, IRQ_DISABLE_UNLAZY);
-	}
+	close_energy_source();
+	restore_interrupts();
 }
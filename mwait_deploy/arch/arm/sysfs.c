@@ -1,31 +1,64 @@
 #include "sysfs.h"
+#include "energy.h"
+
+#include <linux/cpumask.h>
 
 struct pkg_stat pkg_stats;
 struct cpu_stat cpu_stats[MAX_CPUS];
 
+create_attribute(pkg, energy_consumption);
+create_attribute(pkg, energy_duration);
 static struct attribute *pkg_stats_attributes[] = {
     &start_time_attribute,
     &end_time_attribute,
     &repetitions_attribute,
+    &interfered_attribute,
+    &measured_cpus_attribute,
+    &contaminating_cpus_attribute,
+    &contaminated_counters_attribute,
     NULL};
 static struct attribute_group pkg_stats_group = {
     .attrs = pkg_stats_attributes};
+
+static struct attribute *energy_stats_attributes[] = {
+    &pkg_energy_consumption_attribute,
+    &pkg_energy_duration_attribute,
+    NULL};
+
+static umode_t energy_stats_visible(struct kobject *kobj, struct attribute *attr, int index)
+{
+	return energy_source_available() ? attr->mode : 0;
+}
+
+static struct attribute_group energy_stats_group = {
+    .is_visible = energy_stats_visible,
+    .attrs = energy_stats_attributes};
+
 static const struct attribute_group *pkg_stats_groups[] = {
     &pkg_stats_group,
+    &energy_stats_group,
+    &selection_stats_group,
+    &hybrid_stats_group,
     NULL};
 
 static struct attribute *cpu_stats_attributes[] = {
     &cpu_wakeup_time_attribute,
     &cpu_wakeups_attribute,
+    &cpu_interrupts_attribute,
+    &cpu_nmis_attribute,
     NULL};
 static struct attribute_group cpu_stats_group = {
     .attrs = cpu_stats_attributes};
 static const struct attribute_group *cpu_stats_groups[] = {
     &cpu_stats_group,
+    &refill_stats_group,
+    &core_type_stats_group,
     NULL};
 
 ssize_t output_pkg_attributes(struct pkg_stat *stat, struct attribute *attr, char *buf)
 {
+	output_to_sysfs(energy_consumption, measurement_count);
+	output_to_sysfs(energy_duration, measurement_count);
 	return 0;
 }
 
@@ -49,12 +82,15 @@ static const struct kobj_type cpu_ktype = {
     .release = release,
     .default_groups = cpu_stats_groups};
 
-extern unsigned cpus_present;
+extern struct cpumask measured_cpus;
 
 void publish_measurement_results(void)
 {
-	int err = kobject_init_and_add(&(pkg_stats.kobject), &pkg_ktype, NULL, "mwait_measurements");
-	for (unsigned i = 0; i < cpus_present; ++i)
+	int err;
+	unsigned i;
+
+	err = kobject_init_and_add(&(pkg_stats.kobject), &pkg_ktype, NULL, "mwait_measurements");
+	for_each_cpu(i, &measured_cpus)
 	{
 		err |= kobject_init_and_add(&(cpu_stats[i].kobject), &cpu_ktype, &(pkg_stats.kobject), "cpu%u", i);
 	}
@@ -64,7 +100,9 @@ void publish_measurement_results(void)
 
 void cleanup_measurement_results(void)
 {
-	for (unsigned i = 0; i < cpus_present; ++i)
+	unsigned i;
+
+	for_each_cpu(i, &measured_cpus)
 	{
 		kobject_del(&(cpu_stats[i].kobject));
 	}
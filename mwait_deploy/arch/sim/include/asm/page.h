@@ -0,0 +1,8 @@
+#ifndef SIM_ASM_PAGE_H
+#define SIM_ASM_PAGE_H
+
+#include "sim_kernel.h"
+
+#define PAGE_SIZE (4096)
+
+#endif
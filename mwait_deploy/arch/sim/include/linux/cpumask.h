@@ -0,0 +1,6 @@
+#ifndef SIM_LINUX_CPUMASK_H
+#define SIM_LINUX_CPUMASK_H
+
+#include "sim_kernel.h"
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef SIM_LINUX_KERNEL_H
+#define SIM_LINUX_KERNEL_H
+
+#include "sim_kernel.h"
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef SIM_LINUX_KERNEL_READ_FILE_H
+#define SIM_LINUX_KERNEL_READ_FILE_H
+
+#include "sim_kernel.h"
+
+enum kernel_read_file_id
+{
+	READING_UNKNOWN
+};
+
+// reads the whole file into a buffer allocated with vmalloc(), at most buf_size bytes
+ssize_t kernel_read_file_from_path(const char *path, loff_t offset, void **buf, size_t buf_size, size_t *file_size, enum kernel_read_file_id id);
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef SIM_LINUX_KOBJECT_H
+#define SIM_LINUX_KOBJECT_H
+
+#include "sim_kernel.h"
+
+#endif
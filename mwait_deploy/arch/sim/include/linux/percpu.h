@@ -0,0 +1,6 @@
+#ifndef SIM_LINUX_PERCPU_H
+#define SIM_LINUX_PERCPU_H
+
+#include "sim_kernel.h"
+
+#endif
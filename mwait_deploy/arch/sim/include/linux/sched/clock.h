@@ -0,0 +1,6 @@
+#ifndef SIM_LINUX_SCHED_CLOCK_H
+#define SIM_LINUX_SCHED_CLOCK_H
+
+#include "sim_kernel.h"
+
+#endif
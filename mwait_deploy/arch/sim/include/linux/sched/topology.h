@@ -0,0 +1,10 @@
+#ifndef SIM_LINUX_SCHED_TOPOLOGY_H
+#define SIM_LINUX_SCHED_TOPOLOGY_H
+
+#include "sim_kernel.h"
+
+#define SCHED_CAPACITY_SCALE (1024ul)
+
+unsigned long arch_scale_cpu_capacity(int cpu);
+
+#endif
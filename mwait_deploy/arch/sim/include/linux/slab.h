@@ -0,0 +1,11 @@
+#ifndef SIM_LINUX_SLAB_H
+#define SIM_LINUX_SLAB_H
+
+#include <stdlib.h>
+
+#define GFP_KERNEL (0)
+
+#define kmalloc(size, flags) malloc(size)
+#define kfree(ptr) free(ptr)
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef SIM_LINUX_SORT_H
+#define SIM_LINUX_SORT_H
+
+#include <stdlib.h>
+
+// the swap function of the kernel's sort() is always left to the default here
+#define sort(base, num, size, cmp, swap) qsort(base, num, size, cmp)
+
+#endif
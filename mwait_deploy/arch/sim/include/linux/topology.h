@@ -0,0 +1,10 @@
+#ifndef SIM_LINUX_TOPOLOGY_H
+#define SIM_LINUX_TOPOLOGY_H
+
+#include "sim_kernel.h"
+
+// the simulated topology, see sim_smt, sim_llcs and sim_little_cores
+const struct cpumask *topology_sibling_cpumask(int cpu);
+const struct cpumask *topology_die_cpumask(int cpu);
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef SIM_LINUX_TYPES_H
+#define SIM_LINUX_TYPES_H
+
+// also included by system headers, which expect the userspace API types
+#include_next <linux/types.h>
+
+#include "sim_kernel.h"
+
+#endif
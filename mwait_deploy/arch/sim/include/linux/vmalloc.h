@@ -0,0 +1,9 @@
+#ifndef SIM_LINUX_VMALLOC_H
+#define SIM_LINUX_VMALLOC_H
+
+#include <stdlib.h>
+
+#define vmalloc(size) malloc(size)
+#define vfree(ptr) free(ptr)
+
+#endif
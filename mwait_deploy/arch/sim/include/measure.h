@@ -0,0 +1,13 @@
+#ifndef MEASURE_H
+#define MEASURE_H
+
+enum entry_mechanism
+{
+	ENTRY_MECHANISM_UNKNOWN,
+	ENTRY_MECHANISM_POLL,
+	ENTRY_MECHANISM_WAIT
+};
+
+#include "generic/measure.h"
+
+#endif
@@ -0,0 +1,206 @@
+#ifndef SIM_KERNEL_H
+#define SIM_KERNEL_H
+
+// Minimal userspace replacement of the kernel interfaces used by the generic code
+// Every simulated CPU is a pthread, the sysfs is replaced by a directory tree on disk
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <stdatomic.h>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef unsigned long long u64;
+typedef int32_t s32;
+typedef long long s64;
+typedef unsigned short umode_t;
+
+#define NR_CPUS (64)
+#define BITS_PER_LONG (64)
+#define BITS_TO_LONGS(bits) (((bits) + BITS_PER_LONG - 1) / BITS_PER_LONG)
+
+#define likely(x) __builtin_expect(!!(x), 1)
+#define unlikely(x) __builtin_expect(!!(x), 0)
+
+#define container_of(ptr, type, member) ((type *)((char *)(ptr)-offsetof(type, member)))
+#define max(a, b) ((a) > (b) ? (a) : (b))
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#define ARRAY_SIZE(array) (sizeof(array) / sizeof((array)[0]))
+#define swap(a, b)                      \
+	do                              \
+	{                               \
+		__typeof__(a) __tmp = (a); \
+		(a) = (b);              \
+		(b) = __tmp;            \
+	} while (0)
+#define READ_ONCE(x) (*(const volatile __typeof__(x) *)&(x))
+
+// printk
+
+#define KERN_ERR ""
+#define KERN_WARNING ""
+#define KERN_INFO ""
+
+int printk(const char *fmt, ...);
+int scnprintf(char *buf, size_t size, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+
+// strings
+
+static inline int kstrtoull(const char *s, unsigned int base, unsigned long long *res)
+{
+	char *end;
+
+	errno = 0;
+	*res = strtoull(s, &end, base);
+	return errno || end == s || *end != '\0' ? -EINVAL : 0;
+}
+
+// module
+
+enum sim_param_type
+{
+	SIM_PARAM_charp,
+	SIM_PARAM_int
+};
+
+void sim_register_param(const char *name, enum sim_param_type type, void *value);
+void sim_register_param_desc(const char *name, const char *desc);
+
+#define module_param(name, type, perm)                                           \
+	static void __attribute__((constructor)) __sim_param_##name(void)       \
+	{                                                                        \
+		sim_register_param(#name, SIM_PARAM_##type, &name);              \
+	}
+#define MODULE_PARM_DESC(name, desc)                                            \
+	static void __attribute__((constructor)) __sim_param_desc_##name(void) \
+	{                                                                       \
+		sim_register_param_desc(#name, desc);                           \
+	}
+#define MODULE_LICENSE(license) static const char __attribute__((unused)) __sim_license[] = license
+#define module_init(fn) int (*const sim_module_init)(void) = fn
+#define module_exit(fn) void (*const sim_module_exit)(void) = fn
+
+// per-CPU variables and CPU handling
+
+extern __thread int sim_this_cpu;
+
+#define DEFINE_PER_CPU(type, name) __typeof__(type) name[NR_CPUS]
+#define DECLARE_PER_CPU(type, name) extern __typeof__(type) name[NR_CPUS]
+#define per_cpu(var, cpu) ((var)[(cpu)])
+
+extern __thread bool sim_in_hardirq;
+
+#define smp_processor_id() (sim_this_cpu)
+#define in_hardirq() (sim_in_hardirq)
+#define get_cpu() (sim_this_cpu)
+#define put_cpu() \
+	do            \
+	{             \
+	} while (0)
+
+// there are no interrupts to disable in userspace
+#define local_irq_save(flags) ((flags) = 0)
+#define local_irq_restore(flags) ((void)(flags))
+
+typedef struct
+{
+	atomic_int counter;
+} atomic_t;
+
+#define atomic_inc(v) atomic_fetch_add(&(v)->counter, 1)
+#define atomic_read(v) atomic_load(&(v)->counter)
+#define atomic_set(v, i) atomic_store(&(v)->counter, (i))
+
+// cpumask
+
+struct cpumask
+{
+	unsigned long bits[BITS_TO_LONGS(NR_CPUS)];
+};
+
+extern unsigned int nr_cpu_ids;
+extern struct cpumask __cpu_online_mask;
+#define cpu_online_mask ((const struct cpumask *)&__cpu_online_mask)
+
+#define cpumask_bits(mask) ((mask)->bits)
+#define cpumask_pr_args(mask) nr_cpu_ids, cpumask_bits(mask)
+
+unsigned int cpumask_next(int n, const struct cpumask *mask);
+unsigned int cpumask_first(const struct cpumask *mask);
+unsigned int cpumask_last(const struct cpumask *mask);
+unsigned int cpumask_weight(const struct cpumask *mask);
+bool cpumask_empty(const struct cpumask *mask);
+bool cpumask_test_cpu(int cpu, const struct cpumask *mask);
+void cpumask_set_cpu(unsigned int cpu, struct cpumask *mask);
+void cpumask_clear(struct cpumask *mask);
+const struct cpumask *cpumask_of(int cpu);
+void cpumask_copy(struct cpumask *dst, const struct cpumask *src);
+bool cpumask_and(struct cpumask *dst, const struct cpumask *src1, const struct cpumask *src2);
+bool cpumask_andnot(struct cpumask *dst, const struct cpumask *src1, const struct cpumask *src2);
+int cpulist_parse(const char *buf, struct cpumask *dst);
+int cpumap_print_to_pagebuf(bool list, char *buf, const struct cpumask *mask);
+
+// always allocated, as with CONFIG_CPUMASK_OFFSTACK
+typedef struct cpumask *cpumask_var_t;
+#define zalloc_cpumask_var(mask, flags) ((*(mask) = calloc(1, sizeof(struct cpumask))) != NULL)
+#define free_cpumask_var(mask) free(mask)
+
+#define for_each_cpu(cpu, mask) \
+	for ((cpu) = -1; (cpu) = cpumask_next((cpu), (mask)), (cpu) < nr_cpu_ids;)
+
+typedef void (*smp_call_func_t)(void *info);
+void on_each_cpu_mask(const struct cpumask *mask, smp_call_func_t func, void *info, bool wait);
+u64 sim_ipi_count(int cpu);
+
+// time
+
+u64 local_clock(void);
+
+// sysfs
+
+struct attribute
+{
+	const char *name;
+	umode_t mode;
+};
+
+struct kobject;
+
+struct attribute_group
+{
+	const char *name;
+	umode_t (*is_visible)(struct kobject *, struct attribute *, int);
+	struct attribute **attrs;
+};
+
+struct sysfs_ops
+{
+	ssize_t (*show)(struct kobject *, struct attribute *, char *);
+	ssize_t (*store)(struct kobject *, struct attribute *, const char *, size_t);
+};
+
+struct kobj_type
+{
+	void (*release)(struct kobject *kobj);
+	const struct sysfs_ops *sysfs_ops;
+	const struct attribute_group **default_groups;
+};
+
+struct kobject
+{
+	char path[512];
+	struct kobject *parent;
+	const struct kobj_type *ktype;
+};
+
+int kobject_init_and_add(struct kobject *kobj, const struct kobj_type *ktype, struct kobject *parent, const char *fmt, ...)
+    __attribute__((format(printf, 4, 5)));
+void kobject_del(struct kobject *kobj);
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef SYSFS_H
+#define SYSFS_H
+
+#include "consts.h"
+
+#include <linux/types.h>
+
+struct pkg_attributes
+{
+	u64 energy_consumption[MAX_NUMBER_OF_MEASUREMENTS];
+	u64 model_energy_consumption[MAX_NUMBER_OF_MEASUREMENTS];
+};
+
+struct cpu_attributes
+{
+};
+
+#include "generic/sysfs.h"
+
+#endif
@@ -0,0 +1,469 @@
+#include "sim_kernel.h"
+#include <linux/kernel_read_file.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+__thread int sim_this_cpu;
+__thread bool sim_in_hardirq;
+static atomic_ullong sim_ipis[NR_CPUS];
+unsigned int nr_cpu_ids = NR_CPUS;
+struct cpumask __cpu_online_mask;
+
+// printk
+
+static int format_cpulist(char *buf, size_t size, const unsigned long *bits, unsigned int nbits)
+{
+	int written = 0;
+	unsigned int cpu = 0;
+
+	buf[0] = '\0';
+	while (cpu < nbits)
+	{
+		unsigned int end;
+
+		if (!(bits[cpu / BITS_PER_LONG] & (1UL << (cpu % BITS_PER_LONG))))
+		{
+			++cpu;
+			continue;
+		}
+		for (end = cpu; end + 1 < nbits && (bits[(end + 1) / BITS_PER_LONG] & (1UL << ((end + 1) % BITS_PER_LONG))); ++end)
+		{
+		}
+
+		if (end == cpu)
+			written += snprintf(buf + written, size - written, written ? ",%u" : "%u", cpu);
+		else
+			written += snprintf(buf + written, size - written, written ? ",%u-%u" : "%u-%u", cpu, end);
+		if ((size_t)written >= size)
+			return size - 1;
+		cpu = end + 1;
+	}
+	return written;
+}
+
+// The kernel specific '%*pbl' (CPU list) is the only extension used, everything else is passed on to vfprintf
+// It is only supported if no other conversion precedes it, which is all the generic code needs
+int printk(const char *fmt, ...)
+{
+	const char *extension;
+	va_list args;
+	int written;
+
+	va_start(args, fmt);
+	extension = strstr(fmt, "%*pbl");
+	if (!extension || memchr(fmt, '%', extension - fmt))
+	{
+		written = vfprintf(stderr, fmt, args);
+		va_end(args);
+		return written;
+	}
+
+	{
+		char list[512];
+		unsigned int nbits = va_arg(args, unsigned int);
+		const unsigned long *bits = va_arg(args, const unsigned long *);
+
+		format_cpulist(list, sizeof(list), bits, nbits);
+		written = fprintf(stderr, "%.*s%s", (int)(extension - fmt), fmt, list);
+		written += vfprintf(stderr, extension + strlen("%*pbl"), args);
+	}
+	va_end(args);
+	return written;
+}
+
+int scnprintf(char *buf, size_t size, const char *fmt, ...)
+{
+	va_list args;
+	int written;
+
+	if (!size)
+		return 0;
+
+	va_start(args, fmt);
+	written = vsnprintf(buf, size, fmt, args);
+	va_end(args);
+
+	return (size_t)written >= size ? (int)size - 1 : written;
+}
+
+// module parameters
+
+#define MAX_PARAMS (64)
+
+static struct sim_param
+{
+	const char *name;
+	const char *desc;
+	enum sim_param_type type;
+	void *value;
+} params[MAX_PARAMS];
+static int param_count;
+
+static struct sim_param *find_param(const char *name, size_t len, bool create)
+{
+	for (int i = 0; i < param_count; ++i)
+	{
+		if (strlen(params[i].name) == len && strncmp(params[i].name, name, len) == 0)
+			return &params[i];
+	}
+
+	if (!create)
+		return NULL;
+
+	if (param_count == MAX_PARAMS)
+	{
+		fprintf(stderr, "Too many module parameters!\n");
+		exit(1);
+	}
+	params[param_count].name = strndup(name, len);
+	return &params[param_count++];
+}
+
+void sim_register_param(const char *name, enum sim_param_type type, void *value)
+{
+	struct sim_param *param = find_param(name, strlen(name), true);
+	param->type = type;
+	param->value = value;
+}
+
+void sim_register_param_desc(const char *name, const char *desc)
+{
+	find_param(name, strlen(name), true)->desc = desc;
+}
+
+// Takes 'name=value' like insmod does
+int sim_set_param(const char *arg)
+{
+	const char *value = strchr(arg, '=');
+	struct sim_param *param;
+
+	if (!value)
+		return 1;
+
+	param = find_param(arg, value - arg, false);
+	if (!param || !param->value)
+		return 1;
+	++value;
+
+	switch (param->type)
+	{
+	case SIM_PARAM_charp:
+		*(char **)param->value = strdup(value);
+		break;
+	case SIM_PARAM_int:
+		*(int *)param->value = strtol(value, NULL, 0);
+		break;
+	}
+	return 0;
+}
+
+void sim_print_params(void)
+{
+	for (int i = 0; i < param_count; ++i)
+	{
+		if (params[i].value)
+			fprintf(stderr, "%s:\n    %s\n", params[i].name, params[i].desc ? params[i].desc : "");
+	}
+}
+
+// cpumask
+
+unsigned int cpumask_next(int n, const struct cpumask *mask)
+{
+	for (unsigned int cpu = n + 1; cpu < nr_cpu_ids; ++cpu)
+	{
+		if (cpumask_test_cpu(cpu, mask))
+			return cpu;
+	}
+	return nr_cpu_ids;
+}
+
+const struct cpumask *cpumask_of(int cpu)
+{
+	static struct cpumask masks[NR_CPUS];
+
+	cpumask_clear(&masks[cpu]);
+	cpumask_set_cpu(cpu, &masks[cpu]);
+	return &masks[cpu];
+}
+
+unsigned int cpumask_first(const struct cpumask *mask)
+{
+	return cpumask_next(-1, mask);
+}
+
+unsigned int cpumask_last(const struct cpumask *mask)
+{
+	for (int cpu = nr_cpu_ids - 1; cpu >= 0; --cpu)
+	{
+		if (cpumask_test_cpu(cpu, mask))
+			return cpu;
+	}
+	return nr_cpu_ids;
+}
+
+unsigned int cpumask_weight(const struct cpumask *mask)
+{
+	unsigned int weight = 0;
+
+	for (unsigned int i = 0; i < BITS_TO_LONGS(NR_CPUS); ++i)
+		weight += __builtin_popcountl(mask->bits[i]);
+	return weight;
+}
+
+bool cpumask_empty(const struct cpumask *mask)
+{
+	return cpumask_weight(mask) == 0;
+}
+
+bool cpumask_test_cpu(int cpu, const struct cpumask *mask)
+{
+	return mask->bits[cpu / BITS_PER_LONG] & (1UL << (cpu % BITS_PER_LONG));
+}
+
+void cpumask_set_cpu(unsigned int cpu, struct cpumask *mask)
+{
+	mask->bits[cpu / BITS_PER_LONG] |= 1UL << (cpu % BITS_PER_LONG);
+}
+
+void cpumask_clear(struct cpumask *mask)
+{
+	memset(mask, 0, sizeof(*mask));
+}
+
+void cpumask_copy(struct cpumask *dst, const struct cpumask *src)
+{
+	*dst = *src;
+}
+
+bool cpumask_and(struct cpumask *dst, const struct cpumask *src1, const struct cpumask *src2)
+{
+	for (unsigned int i = 0; i < BITS_TO_LONGS(NR_CPUS); ++i)
+		dst->bits[i] = src1->bits[i] & src2->bits[i];
+	return !cpumask_empty(dst);
+}
+
+bool cpumask_andnot(struct cpumask *dst, const struct cpumask *src1, const struct cpumask *src2)
+{
+	for (unsigned int i = 0; i < BITS_TO_LONGS(NR_CPUS); ++i)
+		dst->bits[i] = src1->bits[i] & ~src2->bits[i];
+	return !cpumask_empty(dst);
+}
+
+int cpulist_parse(const char *buf, struct cpumask *dst)
+{
+	cpumask_clear(dst);
+
+	while (*buf)
+	{
+		char *end;
+		unsigned long first, last;
+
+		first = strtoul(buf, &end, 10);
+		if (end == buf)
+			return -EINVAL;
+		last = first;
+		buf = end;
+
+		if (*buf == '-')
+		{
+			last = strtoul(buf + 1, &end, 10);
+			if (end == buf + 1 || last < first)
+				return -EINVAL;
+			buf = end;
+		}
+		if (last >= nr_cpu_ids)
+			return -ERANGE;
+
+		for (unsigned long cpu = first; cpu <= last; ++cpu)
+			cpumask_set_cpu(cpu, dst);
+
+		if (*buf == ',')
+			++buf;
+		else if (*buf)
+			return -EINVAL;
+	}
+	return 0;
+}
+
+int cpumap_print_to_pagebuf(bool list, char *buf, const struct cpumask *mask)
+{
+	int written = format_cpulist(buf, 4096 - 1, mask->bits, nr_cpu_ids);
+
+	buf[written++] = '\n';
+	buf[written] = '\0';
+	return written;
+}
+
+// Every simulated CPU runs on its own thread, pinned to a host CPU if there are enough of them
+// Pinning matters, as the generic code spins while waiting for the other CPUs
+
+struct sim_call
+{
+	pthread_t thread;
+	int cpu;
+	bool remote;
+	smp_call_func_t func;
+	void *info;
+};
+
+static void *sim_call_thread(void *arg)
+{
+	struct sim_call *call = arg;
+
+	sim_this_cpu = call->cpu;
+	sim_in_hardirq = call->remote;
+	call->func(call->info);
+	return NULL;
+}
+
+void on_each_cpu_mask(const struct cpumask *mask, smp_call_func_t func, void *info, bool wait)
+{
+	struct sim_call calls[NR_CPUS];
+	long host_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	int count = 0;
+	unsigned int cpu;
+
+	for_each_cpu(cpu, mask)
+	{
+		pthread_attr_t attr;
+
+		pthread_attr_init(&attr);
+		if (host_cpus >= cpumask_weight(mask))
+		{
+			cpu_set_t host_set;
+
+			CPU_ZERO(&host_set);
+			CPU_SET(cpu % host_cpus, &host_set);
+			pthread_attr_setaffinity_np(&attr, sizeof(host_set), &host_set);
+		}
+
+		// like the kernel, the calling CPU runs the function directly, all others get an IPI
+		calls[count] = (struct sim_call){.cpu = cpu, .remote = (int)cpu != sim_this_cpu, .func = func, .info = info};
+		if (calls[count].remote)
+			atomic_fetch_add(&sim_ipis[cpu], 1);
+		if (pthread_create(&calls[count].thread, &attr, sim_call_thread, &calls[count]))
+		{
+			fprintf(stderr, "Could not create thread for simulated CPU %u!\n", cpu);
+			exit(1);
+		}
+		pthread_attr_destroy(&attr);
+		++count;
+	}
+
+	// the calls live on this stack, so always wait for them
+	(void)wait;
+	for (int i = 0; i < count; ++i)
+		pthread_join(calls[i].thread, NULL);
+}
+
+u64 sim_ipi_count(int cpu)
+{
+	return atomic_load(&sim_ipis[cpu]);
+}
+
+// time
+
+u64 local_clock(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (u64)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+// sysfs, published as a directory tree below the current working directory
+
+int kobject_init_and_add(struct kobject *kobj, const struct kobj_type *ktype, struct kobject *parent, const char *fmt, ...)
+{
+	char name[256];
+	char *buf;
+	va_list args;
+
+	va_start(args, fmt);
+	vsnprintf(name, sizeof(name), fmt, args);
+	va_end(args);
+
+	kobj->parent = parent;
+	kobj->ktype = ktype;
+	snprintf(kobj->path, sizeof(kobj->path), "%s%s%s", parent ? parent->path : "", parent ? "/" : "", name);
+	if (mkdir(kobj->path, 0755) && errno != EEXIST)
+		return -errno;
+
+	buf = malloc(4096);
+	if (!buf)
+		return -ENOMEM;
+
+	for (const struct attribute_group **group = ktype->default_groups; *group; ++group)
+	{
+		for (struct attribute **attr = (*group)->attrs; *attr; ++attr)
+		{
+			char path[768];
+			ssize_t len;
+			FILE *file;
+
+			if ((*group)->is_visible && !(*group)->is_visible(kobj, *attr, attr - (*group)->attrs))
+				continue;
+			len = ktype->sysfs_ops->show(kobj, *attr, buf);
+
+			snprintf(path, sizeof(path), "%s/%s", kobj->path, (*attr)->name);
+			file = fopen(path, "w");
+			if (!file)
+			{
+				free(buf);
+				return -errno;
+			}
+			fwrite(buf, 1, len, file);
+			fclose(file);
+		}
+	}
+
+	free(buf);
+	return 0;
+}
+
+void kobject_del(struct kobject *kobj)
+{
+	if (kobj->ktype && kobj->ktype->release)
+		kobj->ktype->release(kobj);
+}
+
+// files
+
+ssize_t kernel_read_file_from_path(const char *path, loff_t offset, void **buf, size_t buf_size, size_t *file_size, enum kernel_read_file_id id)
+{
+	FILE *file = fopen(path, "rb");
+	long size;
+
+	if (!file)
+		return -ENOENT;
+	if (fseek(file, 0, SEEK_END) || (size = ftell(file)) < 0 || fseek(file, offset, SEEK_SET))
+	{
+		fclose(file);
+		return -EIO;
+	}
+	if ((size_t)size > buf_size)
+	{
+		fclose(file);
+		return -EFBIG;
+	}
+
+	*buf = malloc(size ? size : 1);
+	if (!*buf || fread(*buf, 1, size - offset, file) != (size_t)(size - offset))
+	{
+		free(*buf);
+		fclose(file);
+		return -EIO;
+	}
+	fclose(file);
+
+	*file_size = size;
+	return size - offset;
+}
@@ -0,0 +1,49 @@
+#include "sim_kernel.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// Stands in for insmod/rmmod: takes the module parameters as 'name=value' arguments,
+// runs the module init, which publishes its results below the current directory, and the module exit afterwards
+
+extern int (*const sim_module_init)(void);
+extern void (*const sim_module_exit)(void);
+
+int sim_set_param(const char *arg);
+void sim_print_params(void);
+int sim_cpu_count(void);
+
+int main(int argc, char **argv)
+{
+	int cpus;
+	int err;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0)
+		{
+			fprintf(stderr, "Usage: %s [parameter=value]...\n\n", argv[0]);
+			sim_print_params();
+			return 0;
+		}
+		if (sim_set_param(argv[i]))
+			fprintf(stderr, "Unknown parameter '%s' ignored.\n", argv[i]);
+	}
+
+	cpus = sim_cpu_count();
+	if (cpus < 1 || cpus > NR_CPUS)
+	{
+		fprintf(stderr, "Between 1 and %i CPUs can be simulated.\n", NR_CPUS);
+		return 1;
+	}
+	nr_cpu_ids = cpus;
+	for (int cpu = 0; cpu < cpus; ++cpu)
+		cpumask_set_cpu(cpu, &__cpu_online_mask);
+
+	err = sim_module_init();
+	if (err)
+		return err;
+
+	sim_module_exit();
+	return 0;
+}
@@ -0,0 +1,545 @@
+#include "measure.h"
+#include "sysfs.h"
+
+#include <linux/moduleparam.h>
+#include <linux/topology.h>
+#include <linux/sched/topology.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+// not taken from <linux/futex.h>, as that would pull in the kernel headers this backend replaces
+#define FUTEX_WAIT_PRIVATE (0 | 128)
+#define FUTEX_WAKE_PRIVATE (1 | 128)
+
+static char *entry_mechanism = "WAIT";
+module_param(entry_mechanism, charp, 0);
+MODULE_PARM_DESC(entry_mechanism, "The mechanism used to idle. Supported are 'WAIT' (futex) and 'POLL'. Default is 'WAIT'.");
+static char *efficiency_entry_mechanism = NULL;
+module_param(efficiency_entry_mechanism, charp, 0);
+MODULE_PARM_DESC(efficiency_entry_mechanism, "The mechanism used to idle on the simulated little cores, see sim_little_cores. Default is entry_mechanism.");
+static int sim_cpus = 4;
+module_param(sim_cpus, int, 0);
+MODULE_PARM_DESC(sim_cpus, "Number of simulated CPUs, each one is a thread. Should not exceed the number of host CPUs. Default is 4.");
+static int sim_smt = 0;
+module_param(sim_smt, int, 0);
+MODULE_PARM_DESC(sim_smt, "If set, the simulated cores have two hardware threads each, CPU n and n + sim_cpus / 2 like on Intel. Default is 0.");
+static int sim_llcs = 1;
+module_param(sim_llcs, int, 0);
+MODULE_PARM_DESC(sim_llcs, "Number of simulated last level caches, each one shared by a contiguous range of cores. Default is 1.");
+static int sim_little_cores = 0;
+module_param(sim_little_cores, int, 0);
+MODULE_PARM_DESC(sim_little_cores, "Number of simulated cores with half the capacity of the others, the last ones. Default is 0.");
+static int rapl_period_us = 1000;
+module_param(rapl_period_us, int, 0);
+MODULE_PARM_DESC(rapl_period_us, "Update period of the simulated RAPL counter in microseconds. Default is 1000.");
+static int rapl_wrap_bits = 32;
+module_param(rapl_wrap_bits, int, 0);
+MODULE_PARM_DESC(rapl_wrap_bits, "Width of the simulated RAPL counter in bits, after which it wraps. Default is 32.");
+static int rapl_start = 0;
+module_param(rapl_start, int, 0);
+MODULE_PARM_DESC(rapl_start, "Initial value of the simulated RAPL counter, to provoke wraps early. Default is 0.");
+static int rapl_unit = 610;
+module_param(rapl_unit, int, 0);
+MODULE_PARM_DESC(rapl_unit, "Unit of the simulated RAPL counter in 0.1 microJoule. Default is 610 (2^-14 Joule).");
+static int power_base_mw = 5000;
+module_param(power_base_mw, int, 0);
+MODULE_PARM_DESC(power_base_mw, "Simulated power of the package independent of its CPUs in milliWatt. Default is 5000.");
+static int power_poll_mw = 1500;
+module_param(power_poll_mw, int, 0);
+MODULE_PARM_DESC(power_poll_mw, "Simulated power of a polling or running CPU in milliWatt. Default is 1500.");
+static int power_wait_mw = 100;
+module_param(power_wait_mw, int, 0);
+MODULE_PARM_DESC(power_wait_mw, "Simulated power of a waiting CPU in milliWatt. Default is 100.");
+static int wakeup_interval_us = 0;
+module_param(wakeup_interval_us, int, 0);
+MODULE_PARM_DESC(wakeup_interval_us, "Mean interval of injected wakeups of each waiting CPU in microseconds. Default is 0 (none).");
+static int seed = 1;
+module_param(seed, int, 0);
+MODULE_PARM_DESC(seed, "Seed for the injected wakeups. Default is 1.");
+
+enum sim_cpu_state
+{
+	SIM_CPU_RUNNING,
+	SIM_CPU_POLL,
+	SIM_CPU_WAIT
+};
+
+static volatile int measurement_ongoing;
+
+static u64 deadline;
+static u64 wakeup_trigger_time;
+static u64 end_time_local;
+DEFINE_PER_CPU(u64, wakeup_stamp);
+DEFINE_PER_CPU(unsigned int, random_state);
+DEFINE_PER_CPU(u64, injected_wakeups);
+
+// Energy model, in picoJoule (milliWatt * nanoseconds)
+// Like RAPL, the published value is only updated once per period
+static pthread_mutex_t energy_lock = PTHREAD_MUTEX_INITIALIZER;
+DEFINE_PER_CPU(enum sim_cpu_state, cpu_state);
+static u64 model_energy, model_energy_time, model_power, published_energy;
+
+static u64 start_rapl, final_rapl, energy_consumption;
+static u64 start_model_energy, final_model_energy, model_energy_consumption;
+
+static inline u64 rapl_mask(void)
+{
+	return rapl_wrap_bits >= 64 ? ~0ULL : (1ULL << rapl_wrap_bits) - 1;
+}
+
+static u64 get_state_power(enum sim_cpu_state state)
+{
+	return state == SIM_CPU_WAIT ? power_wait_mw : power_poll_mw;
+}
+
+// needs energy_lock
+static void update_energy(u64 now)
+{
+	u64 period = (u64)rapl_period_us * 1000;
+	u64 boundary = now - now % period;
+
+	if (boundary > model_energy_time)
+		published_energy = model_energy + model_power * (boundary - model_energy_time);
+
+	model_energy += model_power * (now - model_energy_time);
+	model_energy_time = now;
+}
+
+static void set_cpu_state(int this_cpu, enum sim_cpu_state state)
+{
+	pthread_mutex_lock(&energy_lock);
+	update_energy(local_clock());
+	model_power += get_state_power(state) - get_state_power(per_cpu(cpu_state, this_cpu));
+	per_cpu(cpu_state, this_cpu) = state;
+	pthread_mutex_unlock(&energy_lock);
+}
+
+static u64 read_rapl(void)
+{
+	u64 value;
+
+	pthread_mutex_lock(&energy_lock);
+	update_energy(local_clock());
+	value = published_energy;
+	pthread_mutex_unlock(&energy_lock);
+
+	return ((u64)rapl_start + value / ((u64)rapl_unit * 100000)) & rapl_mask();
+}
+
+static u64 read_model_energy(void)
+{
+	u64 value;
+
+	pthread_mutex_lock(&energy_lock);
+	update_energy(local_clock());
+	value = model_energy;
+	pthread_mutex_unlock(&energy_lock);
+
+	return value;
+}
+
+static void futex_wait(volatile int *addr, int value, u64 timeout)
+{
+	struct timespec ts = {.tv_sec = timeout / 1000000000, .tv_nsec = timeout % 1000000000};
+
+	syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, value, timeout ? &ts : NULL, NULL, 0);
+}
+
+static void futex_wake_all(volatile int *addr)
+{
+	syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
+
+// uniformly distributed around wakeup_interval_us
+static u64 get_next_injected_wakeup(int this_cpu, u64 now)
+{
+	if (!wakeup_interval_us)
+		return ULLONG_MAX;
+
+	return now + (u64)rand_r(&per_cpu(random_state, this_cpu)) % (2000ULL * wakeup_interval_us);
+}
+
+// what the NMI handler does on real hardware
+static inline void end_window(void)
+{
+	end_time_local = local_clock();
+	leader_callback();
+}
+
+// wakes every CPU whatever it waits with, the little cores with efficiency_entry_mechanism as well,
+// like the IPIs of x86 to each CPU whose entry mechanism needs one
+void wakeup_other_cpus(void)
+{
+	wakeup_trigger_time = local_clock();
+	measurement_ongoing = false;
+	futex_wake_all(&measurement_ongoing);
+}
+
+void set_global_start_values(void)
+{
+	u64 original_value = read_rapl();
+
+	do
+	{
+		start_rapl = read_rapl();
+	} while (original_value == start_rapl);
+
+	start_model_energy = read_model_energy();
+}
+
+void set_cpu_start_values(int this_cpu)
+{
+}
+
+void setup_leader_wakeup(int this_cpu)
+{
+	deadline = local_clock() + (u64)duration * 1000000;
+}
+
+void setup_wakeup(int this_cpu)
+{
+}
+
+void set_global_final_values(void)
+{
+	final_rapl = read_rapl();
+	final_model_energy = read_model_energy();
+}
+
+void set_cpu_final_values(int this_cpu)
+{
+}
+
+void do_system_specific_sleep(int this_cpu)
+{
+	// handle POLL entry mechanism separately to minimize fluctuation
+	if (per_cpu(cpu_entry_mechanism, this_cpu) == ENTRY_MECHANISM_POLL)
+	{
+		set_cpu_state(this_cpu, SIM_CPU_POLL);
+		while (measurement_ongoing)
+		{
+			per_cpu(wakeups, this_cpu) += 1;
+
+			if (is_leader(this_cpu) && local_clock() >= deadline)
+				end_window();
+		}
+
+		per_cpu(wakeup_stamp, this_cpu) = local_clock();
+		set_cpu_state(this_cpu, SIM_CPU_RUNNING);
+		all_cpus_callback(this_cpu);
+		return;
+	}
+
+	set_cpu_state(this_cpu, SIM_CPU_WAIT);
+	while (measurement_ongoing)
+	{
+		u64 now = local_clock();
+		u64 next_event = get_next_injected_wakeup(this_cpu, now);
+
+		if (is_leader(this_cpu) && deadline < next_event)
+			next_event = deadline;
+
+		if (next_event > now)
+			futex_wait(&measurement_ongoing, true, next_event == ULLONG_MAX ? 0 : next_event - now);
+
+		per_cpu(wakeup_stamp, this_cpu) = local_clock();
+		if (is_leader(this_cpu) && per_cpu(wakeup_stamp, this_cpu) >= deadline)
+			end_window();
+		else if (measurement_ongoing && per_cpu(wakeup_stamp, this_cpu) >= next_event)
+			per_cpu(injected_wakeups, this_cpu) += 1;
+
+		per_cpu(wakeups, this_cpu) += 1;
+	}
+	set_cpu_state(this_cpu, SIM_CPU_RUNNING);
+
+	all_cpus_callback(this_cpu);
+}
+
+bool is_measurement_ongoing(void)
+{
+	return measurement_ongoing;
+}
+
+// the end of a replayed idle period is a timeout of the wait, the hint is not simulated
+void do_system_specific_idle(int this_cpu, enum entry_mechanism mechanism, u64 hint, u64 idle_ns)
+{
+	u64 now = local_clock();
+	u64 idle_end = now + idle_ns;
+
+	if (mechanism == ENTRY_MECHANISM_POLL)
+	{
+		set_cpu_state(this_cpu, SIM_CPU_POLL);
+		while (measurement_ongoing && local_clock() < idle_end)
+		{
+		}
+	}
+	else
+	{
+		set_cpu_state(this_cpu, SIM_CPU_WAIT);
+		while (measurement_ongoing && (now = local_clock()) < idle_end)
+			futex_wait(&measurement_ongoing, true, idle_end - now);
+	}
+
+	per_cpu(wakeup_stamp, this_cpu) = local_clock();
+	set_cpu_state(this_cpu, SIM_CPU_RUNNING);
+}
+
+void evaluate_global(void)
+{
+	final_rapl &= rapl_mask();
+
+	// handle overflow
+	if (final_rapl >= start_rapl)
+	{
+		final_rapl -= start_rapl;
+	}
+	else
+	{
+		final_rapl += rapl_mask() + 1 - start_rapl;
+
+		printk(KERN_INFO "Overflow in Package RAPL register.\n");
+	}
+
+	energy_consumption = final_rapl * rapl_unit;
+	model_energy_consumption = (final_model_energy - start_model_energy) / 100000; // picoJoule to 0.1 microJoule
+}
+
+void evaluate_cpu(int this_cpu)
+{
+	if (is_leader(this_cpu))
+	{
+		per_cpu(wakeup_time, this_cpu) = end_time_local - deadline;
+	}
+	else
+	{
+		per_cpu(wakeup_time, this_cpu) = per_cpu(wakeup_stamp, this_cpu) - wakeup_trigger_time;
+	}
+}
+
+void prepare_before_each_measurement(void)
+{
+	measurement_ongoing = true;
+}
+
+void cleanup_after_each_measurement(void)
+{
+}
+
+inline void commit_system_specific_results(unsigned number)
+{
+	pkg_stats.attributes.energy_consumption[number] = energy_consumption;
+	pkg_stats.attributes.model_energy_consumption[number] = model_energy_consumption;
+}
+
+int sim_cpu_count(void)
+{
+	return sim_cpus;
+}
+
+// the topology is only simulated for selecting the sleeping CPUs, it does not change the simulated power
+static int get_sim_core(int cpu)
+{
+	return sim_smt ? cpu % max(sim_cpus / 2, 1) : cpu;
+}
+
+static int get_sim_core_count(void)
+{
+	return sim_smt ? max(sim_cpus / 2, 1) : sim_cpus;
+}
+
+const struct cpumask *topology_sibling_cpumask(int cpu)
+{
+	static struct cpumask masks[NR_CPUS];
+	int i;
+
+	cpumask_clear(&masks[cpu]);
+	for (i = 0; i < sim_cpus; ++i)
+	{
+		if (get_sim_core(i) == get_sim_core(cpu))
+			cpumask_set_cpu(i, &masks[cpu]);
+	}
+	return &masks[cpu];
+}
+
+const struct cpumask *get_llc_cpumask(int cpu)
+{
+	static struct cpumask masks[NR_CPUS];
+	int cores_per_llc = max(get_sim_core_count() / max(sim_llcs, 1), 1);
+	int i;
+
+	cpumask_clear(&masks[cpu]);
+	for (i = 0; i < sim_cpus; ++i)
+	{
+		if (get_sim_core(i) / cores_per_llc == get_sim_core(cpu) / cores_per_llc)
+			cpumask_set_cpu(i, &masks[cpu]);
+	}
+	return &masks[cpu];
+}
+
+const struct cpumask *topology_die_cpumask(int cpu)
+{
+	return cpu_online_mask;
+}
+
+static bool is_sim_little_core(int cpu)
+{
+	return get_sim_core(cpu) >= get_sim_core_count() - sim_little_cores;
+}
+
+unsigned long arch_scale_cpu_capacity(int cpu)
+{
+	return is_sim_little_core(cpu) ? SCHED_CAPACITY_SCALE / 2 : SCHED_CAPACITY_SCALE;
+}
+
+// with little cores, the simulated CPU is hybrid
+enum core_type get_core_type(int cpu)
+{
+	if (sim_little_cores <= 0)
+		return CORE_TYPE_UNKNOWN;
+	return is_sim_little_core(cpu) ? CORE_TYPE_EFFICIENCY : CORE_TYPE_PERFORMANCE;
+}
+
+void preliminary_checks(void)
+{
+	long host_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+	printk(KERN_INFO "Simulating %i CPUs on %li host CPUs.\n", sim_cpus, host_cpus);
+	if (sim_cpus > host_cpus)
+	{
+		printk(KERN_WARNING "WARNING: More simulated than host CPUs, spinning CPUs will slow each other down considerably.\n");
+	}
+}
+
+void disable_percpu_interrupts(int this_cpu)
+{
+}
+
+void enable_percpu_interrupts(int this_cpu)
+{
+}
+
+inline enum entry_mechanism get_signal_low_mechanism(void)
+{
+	return ENTRY_MECHANISM_WAIT;
+}
+
+int prepare_replay(void)
+{
+	return 0;
+}
+
+// the simulated wait has no hints
+u64 get_entry_hint(int cpu)
+{
+	return 0;
+}
+
+static enum entry_mechanism efficiency_requested_entry_mechanism;
+
+enum entry_mechanism get_requested_entry_mechanism(int cpu)
+{
+	return get_core_type(cpu) == CORE_TYPE_EFFICIENCY ? efficiency_requested_entry_mechanism : requested_entry_mechanism;
+}
+
+unsigned get_entry_hints(u64 *hints, unsigned max)
+{
+	return 0;
+}
+
+// the simulated package contains all simulated CPUs
+const struct cpumask *get_package_counter_scope(int cpu)
+{
+	return cpu_online_mask;
+}
+
+static const char *package_level_counters[] = {"energy_consumption", NULL};
+
+const char **get_package_level_counters(void)
+{
+	return package_level_counters;
+}
+
+// the function call IPIs of the shim and the injected wakeups
+u64 get_interrupt_count(int cpu)
+{
+	return sim_ipi_count(cpu) + per_cpu(injected_wakeups, cpu);
+}
+
+u64 get_nmi_count(int cpu)
+{
+	return 0;
+}
+
+int prepare(void)
+{
+	unsigned cpu;
+
+	if (rapl_period_us < 1 || rapl_unit < 1 || rapl_wrap_bits < 1)
+	{
+		printk(KERN_ERR "Invalid simulated RAPL configuration, aborting!\n");
+		return 1;
+	}
+
+	model_energy_time = local_clock();
+	model_power = power_base_mw;
+	for_each_cpu(cpu, cpu_online_mask)
+	{
+		per_cpu(cpu_state, cpu) = SIM_CPU_RUNNING;
+		per_cpu(random_state, cpu) = seed + cpu;
+		model_power += get_state_power(SIM_CPU_RUNNING);
+	}
+
+	return 0;
+}
+
+static int set_entry_mechanism(const char *name, enum entry_mechanism *mechanism)
+{
+	if (strcmp(name, "POLL") == 0)
+	{
+		*mechanism = ENTRY_MECHANISM_POLL;
+	}
+	else if (strcmp(name, "WAIT") == 0)
+	{
+		*mechanism = ENTRY_MECHANISM_WAIT;
+	}
+	else
+	{
+		*mechanism = ENTRY_MECHANISM_UNKNOWN;
+		printk(KERN_ERR "Entry mechanism '%s' unknown, aborting!\n", name);
+		return 1;
+	}
+	return 0;
+}
+
+int prepare_measurements(void)
+{
+	printk(KERN_INFO "Using entry mechanism '%s'.\n", entry_mechanism);
+	if (set_entry_mechanism(entry_mechanism, &requested_entry_mechanism))
+		return 1;
+
+	efficiency_requested_entry_mechanism = requested_entry_mechanism;
+	if (efficiency_entry_mechanism)
+	{
+		if (!is_hybrid())
+		{
+			printk(KERN_ERR "efficiency_entry_mechanism requires little cores, aborting!\n");
+			return 1;
+		}
+		printk(KERN_INFO "Using entry mechanism '%s' on the little cores.\n", efficiency_entry_mechanism);
+		if (set_entry_mechanism(efficiency_entry_mechanism, &efficiency_requested_entry_mechanism))
+			return 1;
+	}
+
+	return 0;
+}
+
+void cleanup_measurements(void)
+{
+}
+
+void cleanup(void)
+{
+}
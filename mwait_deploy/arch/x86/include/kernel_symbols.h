@@ -0,0 +1,56 @@
+#ifndef KERNEL_SYMBOLS_H
+#define KERNEL_SYMBOLS_H
+
+#include <linux/types.h>
+
+#ifdef STOCK_KERNEL
+
+// Without the linuxMWAIT kernel, the functions it adds for programming HPET and IOAPIC do not exist,
+// leaving only the TSC deadline timer, which needs no NMI, to end measurements.
+static inline u64 get_hpet_counter(void)
+{
+	return 0;
+}
+
+static inline u64 setup_hpet_for_measurement(int duration, int pin)
+{
+	return 0;
+}
+
+static inline void restore_hpet_after_measurement(void)
+{
+}
+
+static inline u32 get_hpet_period(void)
+{
+	return 0;
+}
+
+static inline int select_hpet_pin(void)
+{
+	return -1;
+}
+
+static inline void setup_ioapic_for_measurement(int apic_id, int pin)
+{
+}
+
+static inline void restore_ioapic_after_measurement(void)
+{
+}
+
+static inline bool hpet_timer_available(void)
+{
+	return false;
+}
+
+#else
+
+static inline bool hpet_timer_available(void)
+{
+	return true;
+}
+
+#endif
+
+#endif
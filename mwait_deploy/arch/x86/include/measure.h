@@ -6,14 +6,52 @@
 #define IA32_FIXED_CTR_CTRL (0x38d)
 #define IA32_PERF_GLOBAL_CTRL (0x38f)
 
+// fields of MSR_PKG_CST_CONFIG_CONTROL, the limit has three or four bits depending on the model
+#define PKG_CST_LIMIT_MASK (0xfull)
+#define PKG_CST_CFG_LOCK (1ull << 15)
+#define PKG_CST_C3_AUTO_DEMOTION (1ull << 25)
+#define PKG_CST_C1_AUTO_DEMOTION (1ull << 26)
+#define PKG_CST_C3_UNDEMOTION (1ull << 27)
+#define PKG_CST_C1_UNDEMOTION (1ull << 28)
+
+// CPUID leaf 0x1a EAX[31:24] holds the core type of the executing CPU on hybrid parts
+#define CPUID_HYBRID_LEAF (0x1a)
+#define CPUID_CORE_TYPE_SHIFT (24)
+#define CPUID_CORE_TYPE_ATOM (0x20)
+#define CPUID_CORE_TYPE_CORE (0x40)
+
+// a module cannot allocate an interrupt vector of its own, so the timers and IPIs waking the CPUs use the one of irq_work
+// its handler does nothing without queued work and is not counted by get_interrupt_count(),
+// so its delivery once interrupts are enabled again after a window is harmless
+#define WAKEUP_VECTOR IRQ_WORK_VECTOR
+
 enum entry_mechanism
 {
 	ENTRY_MECHANISM_UNKNOWN,
 	ENTRY_MECHANISM_POLL,
 	ENTRY_MECHANISM_MWAIT,
-	ENTRY_MECHANISM_IOPORT
+	ENTRY_MECHANISM_IOPORT,
+	ENTRY_MECHANISM_HLT,
+	ENTRY_MECHANISM_UMWAIT,
+	ENTRY_MECHANISM_TPAUSE,
+	ENTRY_MECHANISM_MWAITX
+};
+
+enum window_timer
+{
+	WINDOW_TIMER_UNKNOWN,
+	WINDOW_TIMER_HPET,
+	WINDOW_TIMER_TSC_DEADLINE
 };
 
+#define read_msr(msr, p)                           \
+	({                                         \
+		if (unlikely(rdmsrl_safe(msr, p))) \
+			rdmsr_error(#msr, msr);    \
+	})
+
+void rdmsr_error(char *reg, unsigned reg_nr);
+
 #include "generic/measure.h"
 
 #endif
\ No newline at end of file
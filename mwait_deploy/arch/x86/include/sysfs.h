@@ -13,6 +13,15 @@ struct pkg_attributes
 	u64 c3[MAX_NUMBER_OF_MEASUREMENTS];
 	u64 c6[MAX_NUMBER_OF_MEASUREMENTS];
 	u64 c7[MAX_NUMBER_OF_MEASUREMENTS];
+	u64 smis[MAX_NUMBER_OF_MEASUREMENTS];
+	u64 pkg_cst_config[MAX_NUMBER_OF_MEASUREMENTS];
+	u64 temperature_start[MAX_NUMBER_OF_MEASUREMENTS];
+	u64 temperature_end[MAX_NUMBER_OF_MEASUREMENTS];
+	u64 throttled[MAX_NUMBER_OF_MEASUREMENTS];
+	u64 throttle_time[MAX_NUMBER_OF_MEASUREMENTS];
+	u64 power_limit[MAX_NUMBER_OF_MEASUREMENTS];
+	u64 tcc_offset[MAX_NUMBER_OF_MEASUREMENTS];
+	u64 cooldown_time[MAX_NUMBER_OF_MEASUREMENTS];
 };
 
 struct cpu_attributes
@@ -22,6 +31,8 @@ struct cpu_attributes
 	u64 c3[MAX_NUMBER_OF_MEASUREMENTS];
 	u64 c6[MAX_NUMBER_OF_MEASUREMENTS];
 	u64 c7[MAX_NUMBER_OF_MEASUREMENTS];
+	u64 temperature[MAX_NUMBER_OF_MEASUREMENTS];
+	u64 throttled[MAX_NUMBER_OF_MEASUREMENTS];
 };
 
 #include "generic/sysfs.h"
@@ -0,0 +1,15 @@
+#ifndef THERMAL_H
+#define THERMAL_H
+
+#include <linux/types.h>
+
+void prepare_thermal(void);
+bool thermal_available(void);
+void set_thermal_start_values(void);
+void set_thermal_final_values(void);
+void set_cpu_thermal_start_values(int this_cpu);
+void set_cpu_thermal_final_values(int this_cpu);
+void commit_thermal_results(unsigned number);
+void wait_for_cooldown(int cpu, int target_temperature, int timeout);
+
+#endif
@@ -1,22 +1,44 @@
 #include "measure.h"
 #include "sysfs.h"
+#include "kernel_symbols.h"
+#include "thermal.h"
 
 #include <linux/moduleparam.h>
+#include <linux/cacheinfo.h>
 #include <asm/mwait.h>
 #include <asm/hpet.h>
 #include <asm/apic.h>
+#include <asm/irq_vectors.h>
 #include <asm/io_apic.h>
 #include <asm/nmi.h>
 #include <asm/msr-index.h>
+#include <linux/topology.h>
+#include <linux/kernel_stat.h>
+#include <asm/hardirq.h>
 
 #define APIC_LVT_TIMER_MODE_MASK (0x3 << 17)
+#define APIC_LVT_TIMER_MODE_ONESHOT (0x0)
+#define APIC_LVT_TIMER_MODE_PERIODIC (1 << 17)
+#define APIC_LVT_TIMER_MODE_TSC_DEADLINE (1 << 18)
+
+// a task priority of the class below the wakeup vector only lets the vectors of its class through
+#define APIC_PRIORITY_CLASS(vector) ((vector) & 0xf0)
+#define WAKEUP_TASK_PRIORITY (APIC_PRIORITY_CLASS(WAKEUP_VECTOR) - 0x10)
 
 static char *entry_mechanism = "MWAIT";
 module_param(entry_mechanism, charp, 0);
-MODULE_PARM_DESC(entry_mechanism, "The mechanism used to enter the C-State. Supported are 'MWAIT', 'IOPORT' and 'POLL'. Default is 'MWAIT'.");
+MODULE_PARM_DESC(entry_mechanism, "The mechanism used to enter the C-State. Supported are 'MWAIT', 'IOPORT', 'HLT', 'UMWAIT', 'TPAUSE', 'MWAITX' and 'POLL'.\n"
+				  "'UMWAIT' and 'TPAUSE' enter C0.1 or C0.2 (see wait_state) and require WAITPKG, 'MWAITX' requires an AMD CPU. Default is 'MWAIT'.");
 static char *mwait_hint = NULL;
 module_param(mwait_hint, charp, 0);
-MODULE_PARM_DESC(mwait_hint, "If entry_mechanism is 'MWAIT', this is the hint that mwait will use. If this is given, target_cstate and target_subcstate are ignored.");
+MODULE_PARM_DESC(mwait_hint, "If entry_mechanism is 'MWAIT' or 'MWAITX', this is the hint that mwait will use. If this is given, target_cstate and target_subcstate are ignored.");
+static char *efficiency_entry_mechanism = NULL;
+module_param(efficiency_entry_mechanism, charp, 0);
+MODULE_PARM_DESC(efficiency_entry_mechanism, "On hybrid CPUs, the mechanism used on the E-cores, e.g. 'POLL' to only measure the P-cores. Default is entry_mechanism.");
+static char *efficiency_mwait_hint = NULL;
+module_param(efficiency_mwait_hint, charp, 0);
+MODULE_PARM_DESC(efficiency_mwait_hint, "On hybrid CPUs, the hint that mwait will use on the E-cores, as their C-states may differ from the ones of the P-cores. "
+					"Default is the hint of the P-cores.");
 static int target_cstate = 1;
 module_param(target_cstate, int, 0);
 MODULE_PARM_DESC(target_cstate, "If entry_mechanism is 'MWAIT', and mwait_hint is not given, the mwait hint to request this C-state is calculated automatically. Default is 1.");
@@ -26,9 +48,50 @@ MODULE_PARM_DESC(target_subcstate, "If entry_mechanism is 'MWAIT', and mwait_hin
 static char *io_port = NULL;
 module_param(io_port, charp, 0);
 MODULE_PARM_DESC(io_port, "If entry_mechanism is 'IOPORT', this needs to contain the io port address that has to be read.");
+static int wait_state = 2;
+module_param(wait_state, int, 0);
+MODULE_PARM_DESC(wait_state, "If entry_mechanism is 'UMWAIT' or 'TPAUSE', the optimized state to request, 1 for C0.1 and 2 for C0.2. Default is 2.");
+static long long umwait_max_time = -1;
+module_param(umwait_max_time, llong, 0);
+MODULE_PARM_DESC(umwait_max_time, "If entry_mechanism is 'UMWAIT' or 'TPAUSE', the limit of a single wait in TSC cycles written to IA32_UMWAIT_CONTROL "
+				  "for the measurements, which also allows C0.2. 0 is no limit. Default is -1 (keep the limit of the kernel).");
+static int mwaitx_timer = 0;
+module_param(mwaitx_timer, int, 0);
+MODULE_PARM_DESC(mwaitx_timer, "If entry_mechanism is 'MWAITX', end every wait after this many TSC cycles with the built-in timer, "
+			       "after which the CPU waits again. Default is 0 (timer disabled).");
 static int deactivate_pcstates = 0;
 module_param(deactivate_pcstates, int, 0);
 MODULE_PARM_DESC(deactivate_pcstates, "Deactivate Package C-states for the duration of the measurement. Default is '0' (PC-states enabled). '1' deactivates PC-states.");
+static int pkg_cstate_limit = -1;
+module_param(pkg_cstate_limit, int, 0);
+MODULE_PARM_DESC(pkg_cstate_limit, "The Package C-state limit written to MSR_PKG_CST_CONFIG_CONTROL for the duration of the measurement (Intel), "
+				   "its encoding depends on the model, e.g. 0 for PC0, 1 for PC2 and 3 for PC6 on many server parts.\n"
+				   "Overrides deactivate_pcstates. Default is -1 (no limit, or PC0 with deactivate_pcstates).");
+static int auto_demotion = -1;
+module_param(auto_demotion, int, 0);
+MODULE_PARM_DESC(auto_demotion, "The C-state auto-demotion settings written to MSR_PKG_CST_CONFIG_CONTROL for the duration of the measurement (Intel), "
+				"as a bit mask: 1 enables C1 auto-demotion, 2 C3 auto-demotion, 4 C1 undemotion and 8 C3 undemotion.\n"
+				"Default is -1 (keep the current settings).");
+#ifdef STOCK_KERNEL
+static char *timer = "TSC_DEADLINE";
+#else
+static char *timer = "HPET";
+#endif
+module_param(timer, charp, 0);
+MODULE_PARM_DESC(timer, "The timer that ends a measurement. Supported are 'HPET' and 'TSC_DEADLINE'.\n"
+			"'HPET' routes an NMI of the HPET through the IOAPIC to the leader and requires the linuxMWAIT kernel, "
+			"'TSC_DEADLINE' uses the Local APIC timer of the leader in TSC-deadline mode, whose interrupt ends its wait even though interrupts are disabled.\n"
+			"Default is 'HPET', or 'TSC_DEADLINE' if the module was built against an unmodified kernel.");
+static int cooldown_temperature = 0;
+module_param(cooldown_temperature, int, 0);
+MODULE_PARM_DESC(cooldown_temperature, "Before each measurement, wait until the package has cooled down to this temperature in degrees Celsius (Intel), "
+				       "so that measurements taken at different times of a long campaign are comparable. Default is 0 (do not wait).");
+static int cooldown_timeout = 60;
+module_param(cooldown_timeout, int, 0);
+MODULE_PARM_DESC(cooldown_timeout, "Maximum time in seconds to wait for the package to cool down, afterwards it is measured anyway. Default is 60.");
+static int smi_threshold = 0;
+module_param(smi_threshold, int, 0);
+MODULE_PARM_DESC(smi_threshold, "A measurement is redone if more System Management Interrupts than this occurred during it (Intel). Default is 0.");
 
 // make sure that there is enough unused space around measurement_ongoing
 // necessary because monitor surveils entire lines of memory
@@ -42,13 +105,20 @@ struct
 } padding;
 
 static u32 calculated_mwait_hint;
+static u32 calculated_efficiency_mwait_hint;
+static enum entry_mechanism efficiency_requested_entry_mechanism;
+static DEFINE_PER_CPU(u32, cpu_mwait_hint);
+static DEFINE_PER_CPU(enum core_type, cpu_core_type);
+static u32 calculated_wait_state;
 static u16 calculated_io_port;
 static u32 rapl_unit;
 static int hpet_pin;
 static u32 hpet_period;
 static u32 cpu_model;
 static u32 cpu_family;
+static bool mwait_interrupt_break;
 static int first;
+static enum window_timer window_timer;
 
 unsigned vendor;
 
@@ -74,7 +144,14 @@ static u64 start_pkg_c2, final_pkg_c2;
 static u64 start_pkg_c3, final_pkg_c3;
 static u64 start_pkg_c6, final_pkg_c6;
 static u64 start_pkg_c7, final_pkg_c7;
+static u64 start_smi, final_smi;
+static u64 pkg_cst_config;
 static u64 hpet_comparator, hpet_counter;
+static u64 tsc_deadline, tsc_deadline_counter;
+
+// interrupts and NMIs the module causes itself, they are not interference
+static DEFINE_PER_CPU(u64, expected_interrupts);
+static DEFINE_PER_CPU(u64, expected_nmis);
 
 static inline bool is_cpu_model(u32 family, u32 model)
 {
@@ -83,14 +160,23 @@ static inline bool is_cpu_model(u32 family, u32 model)
 
 static int measurement_callback(unsigned int val, struct pt_regs *regs)
 {
+	u64 counter_local;
+	int this_cpu;
+
+	// the TSC deadline timer sends no NMI, the leader ends the window itself, see check_tsc_deadline()
+	if (window_timer != WINDOW_TIMER_HPET)
+		return NMI_DONE;
+
 	// this measurement is taken here to get the value as early as possible
-	u64 hpet_counter_local = get_hpet_counter();
+	counter_local = get_hpet_counter();
 
-	int this_cpu = smp_processor_id();
+	this_cpu = smp_processor_id();
 
 	if (!is_leader(this_cpu))
 		return NMI_HANDLED;
 
+	per_cpu(expected_nmis, this_cpu) += 1;
+
 	if (!first && is_cpu_model(0x6, 0x5e))
 	{
 		++first;
@@ -98,30 +184,48 @@ static int measurement_callback(unsigned int val, struct pt_regs *regs)
 	}
 
 	// only commit the taken time to the global variable if this point is reached
-	hpet_counter = hpet_counter_local;
+	hpet_counter = counter_local;
 
 	leader_callback();
 
 	return NMI_HANDLED;
 }
 
+// the memory write of the leader ends polling, MWAIT, MWAITX and UMWAIT, the other mechanisms need an interrupt,
+// decided per CPU as the E-cores may use another entry mechanism than the P-cores
+static struct cpumask wakeup_ipi_cpus;
+
 void wakeup_other_cpus(void)
 {
+	int this_cpu = smp_processor_id();
+	unsigned cpu;
+
 	wakeup_trigger_tsc = rdtsc();
 	padding.measurement_ongoing = false;
-	if (requested_entry_mechanism == ENTRY_MECHANISM_IOPORT)
+
+	cpumask_clear(&wakeup_ipi_cpus);
+	for_each_cpu(cpu, &measured_cpus)
 	{
-		apic->send_IPI_allbutself(LOCAL_TIMER_VECTOR);
+		switch (per_cpu(cpu_entry_mechanism, cpu))
+		{
+		case ENTRY_MECHANISM_IOPORT:
+		case ENTRY_MECHANISM_TPAUSE:
+			if (cpu != this_cpu)
+				cpumask_set_cpu(cpu, &wakeup_ipi_cpus);
+			break;
+		case ENTRY_MECHANISM_HLT:
+			// the leader may also be about to halt, the pending interrupt wakes it right after 'sti; hlt'
+			cpumask_set_cpu(cpu, &wakeup_ipi_cpus);
+			break;
+		default:
+			break;
+		}
 	}
+	if (!cpumask_empty(&wakeup_ipi_cpus))
+		apic->send_IPI_mask(&wakeup_ipi_cpus, WAKEUP_VECTOR);
 }
 
-#define read_msr(msr, p)                           \
-	({                                         \
-		if (unlikely(rdmsrl_safe(msr, p))) \
-			rdmsr_error(#msr, msr);    \
-	})
-
-static void rdmsr_error(char *reg, unsigned reg_nr)
+void rdmsr_error(char *reg, unsigned reg_nr)
 {
 	printk(KERN_WARNING "WARNING: Failed to read register %s (%u).\n", reg, reg_nr);
 }
@@ -140,6 +244,9 @@ void wait_for_rapl_update(void)
 
 void set_global_start_values(void)
 {
+	if (vendor == X86_VENDOR_INTEL)
+		read_msr(MSR_PKG_CST_CONFIG_CONTROL, &pkg_cst_config);
+
 	wait_for_rapl_update();
 	start_tsc = rdtsc();
 
@@ -149,6 +256,9 @@ void set_global_start_values(void)
 		read_msr(MSR_PKG_C3_RESIDENCY, &start_pkg_c3);
 		read_msr(MSR_PKG_C6_RESIDENCY, &start_pkg_c6);
 		read_msr(MSR_PKG_C7_RESIDENCY, &start_pkg_c7);
+		read_msr(MSR_SMI_COUNT, &start_smi);
+		if (thermal_available())
+			set_thermal_start_values();
 	}
 }
 
@@ -160,6 +270,8 @@ void set_cpu_start_values(int this_cpu)
 		read_msr(MSR_CORE_C3_RESIDENCY, &per_cpu(start_c3, this_cpu));
 		read_msr(MSR_CORE_C6_RESIDENCY, &per_cpu(start_c6, this_cpu));
 		read_msr(MSR_CORE_C7_RESIDENCY, &per_cpu(start_c7, this_cpu));
+		if (thermal_available())
+			set_cpu_thermal_start_values(this_cpu);
 	}
 	else if (vendor == X86_VENDOR_AMD)
 	{
@@ -167,9 +279,25 @@ void set_cpu_start_values(int this_cpu)
 	}
 }
 
+// The LVT timer entry was masked by disable_percpu_interrupts() and is restored from its backup afterwards
+// It has no delivery mode field, so the timer raises a fixed interrupt, which stays pending as interrupts are disabled
+static void setup_tsc_deadline_for_measurement(void)
+{
+	apic_write(APIC_LVTT, APIC_LVT_TIMER_MODE_TSC_DEADLINE | WAKEUP_VECTOR);
+	// in xAPIC mode, the write to the LVT and the one to the MSR are not serialized, see the TSC-deadline mode in the SDM
+	asm volatile("mfence" ::: "memory");
+
+	tsc_deadline = rdtsc() + (u64)duration * tsc_khz;
+	if (wrmsrl_safe(MSR_IA32_TSC_DEADLINE, tsc_deadline))
+		printk(KERN_WARNING "WARNING: Could not arm TSC deadline on CPU %i!\n", smp_processor_id());
+}
+
 void setup_leader_wakeup(int this_cpu)
 {
-	hpet_comparator = setup_hpet_for_measurement(duration, hpet_pin);
+	if (window_timer == WINDOW_TIMER_TSC_DEADLINE)
+		setup_tsc_deadline_for_measurement();
+	else
+		hpet_comparator = setup_hpet_for_measurement(duration, hpet_pin);
 }
 
 void setup_wakeup(int this_cpu)
@@ -187,6 +315,9 @@ void set_global_final_values(void)
 		read_msr(MSR_PKG_C3_RESIDENCY, &final_pkg_c3);
 		read_msr(MSR_PKG_C6_RESIDENCY, &final_pkg_c6);
 		read_msr(MSR_PKG_C7_RESIDENCY, &final_pkg_c7);
+		read_msr(MSR_SMI_COUNT, &final_smi);
+		if (thermal_available())
+			set_thermal_final_values();
 	}
 }
 
@@ -198,6 +329,8 @@ void set_cpu_final_values(int this_cpu)
 		read_msr(MSR_CORE_C3_RESIDENCY, &per_cpu(final_c3, this_cpu));
 		read_msr(MSR_CORE_C6_RESIDENCY, &per_cpu(final_c6, this_cpu));
 		read_msr(MSR_CORE_C7_RESIDENCY, &per_cpu(final_c7, this_cpu));
+		if (thermal_available())
+			set_cpu_thermal_final_values(this_cpu);
 	}
 	else if (vendor == X86_VENDOR_AMD)
 	{
@@ -205,56 +338,287 @@ void set_cpu_final_values(int this_cpu)
 	}
 }
 
-void do_system_specific_sleep(int this_cpu)
+// With the TSC deadline timer, the leader waits in a way that its pending interrupt ends, and ends the window itself
+static inline bool ends_window(int this_cpu)
+{
+	return window_timer == WINDOW_TIMER_TSC_DEADLINE && is_leader(this_cpu);
+}
+
+static inline void check_tsc_deadline(void)
+{
+	u64 counter_local = rdtsc();
+
+	if (counter_local < tsc_deadline)
+		return;
+
+	tsc_deadline_counter = counter_local;
+	leader_callback();
+}
+
+// Every entry mechanism has its own loop, so that the loop itself does not differ in the instructions executed between two waits
+
+// handle POLL entry mechanism separately to minimize fluctuation
+static inline void poll_loop(int this_cpu)
+{
+	bool leader = ends_window(this_cpu);
+
+	while (padding.measurement_ongoing)
+	{
+		per_cpu(wakeups, this_cpu) += 1;
+		if (leader)
+			check_tsc_deadline();
+	}
+
+	per_cpu(wakeup_tsc, this_cpu) = rdtsc();
+}
+
+// the leader lets interrupts end MWAIT even though they are disabled
+static inline void mwait_loop(int this_cpu)
 {
-	// handle POLL entry mechanism separately to minimize fluctuation
-	if (per_cpu(cpu_entry_mechanism, this_cpu) == ENTRY_MECHANISM_POLL)
+	u32 hint = per_cpu(cpu_mwait_hint, this_cpu);
+	bool leader = ends_window(this_cpu);
+	u32 ecx = leader ? MWAIT_ECX_INTERRUPT_BREAK : 0;
+
+	while (padding.measurement_ongoing)
 	{
-		while (padding.measurement_ongoing)
+		asm volatile("monitor;" ::"a"(&padding.measurement_ongoing), "c"(0), "d"(0));
+
+		// could get stuck if write occurs between while and monitor
+		if (padding.measurement_ongoing)
 		{
-			per_cpu(wakeups, this_cpu) += 1;
+			asm volatile("mwait;" ::"a"(hint), "c"(ecx));
+
+			per_cpu(wakeup_tsc, this_cpu) = rdtsc();
+			if (leader)
+				check_tsc_deadline();
 		}
+		per_cpu(wakeups, this_cpu) += 1;
+	}
+}
+
+// interrupts end the C-state even though they are disabled, the ACPI idle driver of the kernel reads the port like this as well
+static inline void ioport_loop(int this_cpu)
+{
+	bool leader = ends_window(this_cpu);
+
+	while (padding.measurement_ongoing)
+	{
+		inb(calculated_io_port);
 
 		per_cpu(wakeup_tsc, this_cpu) = rdtsc();
-		all_cpus_callback(this_cpu);
-		return;
+		if (leader)
+			check_tsc_deadline();
+		per_cpu(wakeups, this_cpu) += 1;
 	}
+}
+
+// with interrupts disabled, only an NMI would end HLT, and one arriving right before it would be missed
+// so interrupts are enabled for the HLT only, like the kernel does, and the wakeup interrupt is handled before the wakeup time is taken
+// the task priority keeps device interrupts and the timer of the kernel pending until the window ended,
+// only IPIs of the highest priority class, which are counted as interference, are handled during the window
+static inline void hlt_loop(int this_cpu)
+{
+	bool leader = ends_window(this_cpu);
+	u32 task_priority = apic_read(APIC_TASKPRI);
 
+	apic_write(APIC_TASKPRI, WAKEUP_TASK_PRIORITY);
 	while (padding.measurement_ongoing)
 	{
-		switch (per_cpu(cpu_entry_mechanism, this_cpu))
-		{
-		case ENTRY_MECHANISM_MWAIT:
-			asm volatile("monitor;" ::"a"(&padding.measurement_ongoing), "c"(0), "d"(0));
+		asm volatile("sti; hlt; cli;" ::: "memory");
 
-			// could get stuck if write occurs between while and monitor
-			if (!padding.measurement_ongoing)
-				break;
+		per_cpu(wakeup_tsc, this_cpu) = rdtsc();
+		if (leader)
+			check_tsc_deadline();
+		per_cpu(wakeups, this_cpu) += 1;
+	}
+	apic_write(APIC_TASKPRI, task_priority);
+}
 
-			asm volatile("mwait;" ::"a"(calculated_mwait_hint), "c"(0));
+// UMWAIT and TPAUSE also end when the TSC reaches the deadline in edx:eax or the limit of IA32_UMWAIT_CONTROL
+// the leader passes the TSC deadline, the other CPUs wait without one
+#define NO_WAIT_DEADLINE (~0ull)
 
-			per_cpu(wakeup_tsc, this_cpu) = rdtsc();
-			break;
+static inline u64 get_wait_deadline(int this_cpu)
+{
+	return ends_window(this_cpu) ? tsc_deadline : NO_WAIT_DEADLINE;
+}
 
-		case ENTRY_MECHANISM_IOPORT:
-			inb(calculated_io_port);
+static inline void umwait_loop(int this_cpu)
+{
+	bool leader = ends_window(this_cpu);
+	u64 deadline = get_wait_deadline(this_cpu);
 
-			per_cpu(wakeup_tsc, this_cpu) = rdtsc();
-			break;
+	while (padding.measurement_ongoing)
+	{
+		// umonitor %rax
+		asm volatile(".byte 0xf3, 0x0f, 0xae, 0xf0;" ::"a"(&padding.measurement_ongoing));
 
-		case ENTRY_MECHANISM_POLL:
-		case ENTRY_MECHANISM_UNKNOWN:
+		if (padding.measurement_ongoing)
+		{
+			// umwait %ecx
+			asm volatile(".byte 0xf2, 0x0f, 0xae, 0xf1;" ::"c"(calculated_wait_state), "d"((u32)(deadline >> 32)), "a"((u32)deadline) : "cc");
 
 			per_cpu(wakeup_tsc, this_cpu) = rdtsc();
-			break;
+			if (leader)
+				check_tsc_deadline();
 		}
+		per_cpu(wakeups, this_cpu) += 1;
+	}
+}
+
+// TPAUSE does not monitor memory, any interrupt ends it even with interrupts disabled
+// if the wakeup arrives right before it, it only ends at the limit of IA32_UMWAIT_CONTROL
+static inline void tpause_loop(int this_cpu)
+{
+	bool leader = ends_window(this_cpu);
+	u64 deadline = get_wait_deadline(this_cpu);
 
+	while (padding.measurement_ongoing)
+	{
+		// tpause %ecx
+		asm volatile(".byte 0x66, 0x0f, 0xae, 0xf1;" ::"c"(calculated_wait_state), "d"((u32)(deadline >> 32)), "a"((u32)deadline) : "cc");
+
+		per_cpu(wakeup_tsc, this_cpu) = rdtsc();
+		if (leader)
+			check_tsc_deadline();
+		per_cpu(wakeups, this_cpu) += 1;
+	}
+}
+
+#define MWAITX_ECX_INTERRUPT_BREAK (1 << 0)
+#define MWAITX_ECX_TIMER_ENABLE (1 << 1)
+
+static inline void mwaitx_loop(int this_cpu)
+{
+	bool leader = ends_window(this_cpu);
+	u32 ecx = (mwaitx_timer ? MWAITX_ECX_TIMER_ENABLE : 0) | (leader ? MWAITX_ECX_INTERRUPT_BREAK : 0);
+	u32 hint = per_cpu(cpu_mwait_hint, this_cpu);
+
+	while (padding.measurement_ongoing)
+	{
+		// monitorx %rax, %ecx, %edx
+		asm volatile(".byte 0x0f, 0x01, 0xfa;" ::"a"(&padding.measurement_ongoing), "c"(0), "d"(0));
+
+		if (padding.measurement_ongoing)
+		{
+			// mwaitx %eax, %ebx, %ecx
+			asm volatile(".byte 0x0f, 0x01, 0xfb;" ::"a"(hint), "b"(mwaitx_timer), "c"(ecx));
+
+			per_cpu(wakeup_tsc, this_cpu) = rdtsc();
+			if (leader)
+				check_tsc_deadline();
+		}
 		per_cpu(wakeups, this_cpu) += 1;
 	}
+}
+
+void do_system_specific_sleep(int this_cpu)
+{
+	switch (per_cpu(cpu_entry_mechanism, this_cpu))
+	{
+	case ENTRY_MECHANISM_MWAIT:
+		mwait_loop(this_cpu);
+		break;
+	case ENTRY_MECHANISM_IOPORT:
+		ioport_loop(this_cpu);
+		break;
+	case ENTRY_MECHANISM_HLT:
+		hlt_loop(this_cpu);
+		break;
+	case ENTRY_MECHANISM_UMWAIT:
+		umwait_loop(this_cpu);
+		break;
+	case ENTRY_MECHANISM_TPAUSE:
+		tpause_loop(this_cpu);
+		break;
+	case ENTRY_MECHANISM_MWAITX:
+		mwaitx_loop(this_cpu);
+		break;
+	case ENTRY_MECHANISM_POLL:
+	case ENTRY_MECHANISM_UNKNOWN:
+		poll_loop(this_cpu);
+		break;
+	}
 
 	all_cpus_callback(this_cpu);
 }
 
+bool is_measurement_ongoing(void)
+{
+	return padding.measurement_ongoing;
+}
+
+#define APIC_IRR_VECTOR_REGISTER(vector) (APIC_IRR + ((vector) / 32) * 0x10)
+
+static inline bool is_wakeup_pending(void)
+{
+	return apic_read(APIC_IRR_VECTOR_REGISTER(WAKEUP_VECTOR)) & BIT(WAKEUP_VECTOR % 32);
+}
+
+// A pending interrupt would end every following MWAIT right away, so it is taken while the task priority blocks all lower vectors
+// Only IPIs of the highest priority class, which are counted as interference, can be handled along with it
+static void take_pending_wakeup(void)
+{
+	u32 task_priority = apic_read(APIC_TASKPRI);
+
+	apic_write(APIC_TASKPRI, WAKEUP_TASK_PRIORITY);
+	asm volatile("sti; nop; cli;" ::: "memory");
+	apic_write(APIC_TASKPRI, task_priority);
+}
+
+#define WAKEUP_PENDING_TIMEOUT (tsc_khz / 100)
+
+// A replayed idle period ends with the interrupt of the Local APIC timer in TSC-deadline mode, like a timer interrupt would end it
+// As interrupts are disabled, it stays pending and MWAIT is told to end on it anyway
+// The LVT timer entry was masked by disable_percpu_interrupts() and is restored from its backup afterwards
+void do_system_specific_idle(int this_cpu, enum entry_mechanism mechanism, u64 hint, u64 idle_ns)
+{
+	u64 deadline = rdtsc() + idle_ns * tsc_khz / 1000000;
+
+	if (mechanism == ENTRY_MECHANISM_POLL)
+	{
+		while (padding.measurement_ongoing && rdtsc() < deadline)
+		{
+		}
+		per_cpu(wakeup_tsc, this_cpu) = rdtsc();
+		return;
+	}
+
+	apic_write(APIC_LVTT, APIC_LVT_TIMER_MODE_TSC_DEADLINE | WAKEUP_VECTOR);
+	// in xAPIC mode, the write to the LVT and the one to the MSR are not serialized, see the TSC-deadline mode in the SDM
+	asm volatile("mfence" ::: "memory");
+	if (wrmsrl_safe(MSR_IA32_TSC_DEADLINE, deadline))
+	{
+		printk_once(KERN_WARNING "WARNING: Could not arm TSC deadline on CPU %i!\n", this_cpu);
+		return;
+	}
+
+	while (padding.measurement_ongoing && rdtsc() < deadline)
+	{
+		asm volatile("monitor;" ::"a"(&padding.measurement_ongoing), "c"(0), "d"(0));
+
+		// could get stuck if write occurs between while and monitor
+		if (padding.measurement_ongoing)
+			asm volatile("mwait;" ::"a"((u32)hint), "c"(MWAIT_ECX_INTERRUPT_BREAK));
+	}
+	per_cpu(wakeup_tsc, this_cpu) = rdtsc();
+
+	if (per_cpu(wakeup_tsc, this_cpu) < deadline)
+	{
+		// the window ended first, the timer may still fire until it is disarmed
+		wrmsrl_safe(MSR_IA32_TSC_DEADLINE, 0);
+	}
+	else
+	{
+		// once the deadline has passed, the interrupt becomes pending shortly
+		while (!is_wakeup_pending() && rdtsc() < deadline + WAKEUP_PENDING_TIMEOUT)
+		{
+		}
+	}
+	if (is_wakeup_pending())
+		take_pending_wakeup();
+}
+
 void evaluate_global(void)
 {
 	final_rapl &= TOTAL_ENERGY_CONSUMED_MASK;
@@ -281,12 +645,21 @@ void evaluate_global(void)
 		final_pkg_c3 -= start_pkg_c3;
 		final_pkg_c6 -= start_pkg_c6;
 		final_pkg_c7 -= start_pkg_c7;
+
+		// SMIs are invisible to the kernel and stall every CPU, so their energy cannot be told apart
+		final_smi = (final_smi - start_smi) & 0xFFFFFFFF;
+		if (final_smi > smi_threshold)
+			redo_measurement = true;
 	}
 }
 
 void evaluate_cpu(int this_cpu)
 {
-	if (is_leader(this_cpu))
+	if (is_leader(this_cpu) && window_timer == WINDOW_TIMER_TSC_DEADLINE)
+	{
+		per_cpu(wakeup_time, this_cpu) = ((tsc_deadline_counter - tsc_deadline) * 1000000) / tsc_khz;
+	}
+	else if (is_leader(this_cpu))
 	{
 		per_cpu(wakeup_time, this_cpu) = ((hpet_counter - hpet_comparator) * hpet_period) / 1000000;
 	}
@@ -325,17 +698,24 @@ void evaluate_cpu(int this_cpu)
 
 void prepare_before_each_measurement(void)
 {
+	// waiting in between the levels of a signal would distort it
+	if (cooldown_temperature && thermal_available() && operation_mode != MODE_SIGNAL)
+		wait_for_cooldown(get_leader_cpu(), cooldown_temperature, cooldown_timeout);
+
 	first = 0;
 	padding.measurement_ongoing = true;
 }
 
 void cleanup_after_each_measurement(void)
 {
-	restore_hpet_after_measurement();
+	if (window_timer == WINDOW_TIMER_HPET)
+		restore_hpet_after_measurement();
 }
 
 inline void commit_system_specific_results(unsigned number)
 {
+	unsigned i;
+
 	pkg_stats.attributes.energy_consumption[number] = energy_consumption;
 	pkg_stats.attributes.total_tsc[number] = final_tsc;
 	if (vendor == X86_VENDOR_INTEL)
@@ -344,9 +724,13 @@ inline void commit_system_specific_results(unsigned number)
 		pkg_stats.attributes.c3[number] = final_pkg_c3;
 		pkg_stats.attributes.c6[number] = final_pkg_c6;
 		pkg_stats.attributes.c7[number] = final_pkg_c7;
+		pkg_stats.attributes.smis[number] = final_smi;
+		pkg_stats.attributes.pkg_cst_config[number] = pkg_cst_config;
+		if (thermal_available())
+			commit_thermal_results(number);
 	}
 
-	for (unsigned i = 0; i < cpus_present; ++i)
+	for_each_cpu(i, &measured_cpus)
 	{
 		if (vendor == X86_VENDOR_INTEL)
 		{
@@ -362,9 +746,58 @@ inline void commit_system_specific_results(unsigned number)
 	}
 }
 
-DEFINE_SPINLOCK(pkg_cst_lock);
-volatile bool first_at_pkg_cst = true;
-static u64 max_pkg_cst_backup;
+// the bits of MSR_PKG_CST_CONFIG_CONTROL the module changes, and their values during the measurements
+static u64 pkg_cst_config_mask;
+static u64 pkg_cst_config_value;
+// the register is per core on some models and per package on others, so every CPU restores its own value
+// all CPUs save it before any of them changes it, otherwise CPUs sharing it would save the changed value
+static DEFINE_PER_CPU(u64, pkg_cst_config_backup);
+
+static void per_cpu_backup_pkg_cst_config(void *info)
+{
+	if (vendor == X86_VENDOR_INTEL)
+		read_msr(MSR_PKG_CST_CONFIG_CONTROL, &per_cpu(pkg_cst_config_backup, smp_processor_id()));
+}
+
+static const u64 auto_demotion_bits[] = {
+    PKG_CST_C1_AUTO_DEMOTION,
+    PKG_CST_C3_AUTO_DEMOTION,
+    PKG_CST_C1_UNDEMOTION,
+    PKG_CST_C3_UNDEMOTION};
+
+static int calculate_pkg_cst_config(void)
+{
+	unsigned i;
+
+	if (pkg_cstate_limit > (int)PKG_CST_LIMIT_MASK || auto_demotion > (int)(BIT(ARRAY_SIZE(auto_demotion_bits)) - 1))
+	{
+		printk(KERN_ERR "pkg_cstate_limit of %i or auto_demotion of %i is invalid, aborting!\n", pkg_cstate_limit, auto_demotion);
+		return 1;
+	}
+
+	if (pkg_cstate_limit >= 0)
+	{
+		pkg_cst_config_mask = PKG_CST_LIMIT_MASK;
+		pkg_cst_config_value = pkg_cstate_limit;
+	}
+	else
+	{
+		// the lowest three bits are the limit on all models, 0b111 is no limit
+		pkg_cst_config_mask = 0b111;
+		pkg_cst_config_value = deactivate_pcstates ? 0 : 0b111;
+	}
+
+	if (auto_demotion >= 0)
+	{
+		for (i = 0; i < ARRAY_SIZE(auto_demotion_bits); ++i)
+		{
+			pkg_cst_config_mask |= auto_demotion_bits[i];
+			if (auto_demotion & BIT(i))
+				pkg_cst_config_value |= auto_demotion_bits[i];
+		}
+	}
+	return 0;
+}
 
 static void per_cpu_init(void *info)
 {
@@ -380,34 +813,15 @@ static void per_cpu_init(void *info)
 
 		err = 0;
 
-		// As the MSR to control Package C-states is somehow a per-core MSR, handling it is a bit of a mess
-		// The current implementation only saves the inital max PC-state value from one core and then restores it to all
-		// Within one package this should not be a problem, as having different values for this field makes not much sense
-		// This might need to be revisited once multiple sockets should be supported
-		spin_lock(&pkg_cst_lock);
-
 		err = rdmsrl_safe(MSR_PKG_CST_CONFIG_CONTROL, &pkg_cst_config_control);
-		if (first_at_pkg_cst)
-		{
-			max_pkg_cst_backup = pkg_cst_config_control & 0b111;
-			first_at_pkg_cst = false;
-		}
-
-		spin_unlock(&pkg_cst_lock);
-
-		if (deactivate_pcstates)
-		{
-			pkg_cst_config_control &= ~0b111; // set last 3 bits to 0
-		}
-		else
-		{
-			pkg_cst_config_control |= 0b111; // set last 3 bits to 1
-		}
+		pkg_cst_config_control &= ~pkg_cst_config_mask;
+		pkg_cst_config_control |= pkg_cst_config_value;
 		err |= wrmsrl_safe(MSR_PKG_CST_CONFIG_CONTROL, pkg_cst_config_control);
 
 		if (err)
 		{
-			printk(KERN_WARNING "WARNING: Could not change Package C-state settings.\n");
+			printk(KERN_WARNING "WARNING: Could not change Package C-state settings%s.\n",
+			       per_cpu(pkg_cst_config_backup, smp_processor_id()) & PKG_CST_CFG_LOCK ? ", they are locked by the firmware" : "");
 		}
 
 		err = 0;
@@ -442,8 +856,8 @@ static void per_cpu_cleanup(void *info)
 		err = 0;
 
 		err = rdmsrl_safe(MSR_PKG_CST_CONFIG_CONTROL, &pkg_cst_config_control);
-		pkg_cst_config_control &= ~0b111;
-		pkg_cst_config_control |= max_pkg_cst_backup;
+		pkg_cst_config_control &= ~pkg_cst_config_mask;
+		pkg_cst_config_control |= per_cpu(pkg_cst_config_backup, smp_processor_id()) & pkg_cst_config_mask;
 		err |= wrmsrl_safe(MSR_PKG_CST_CONFIG_CONTROL, pkg_cst_config_control);
 
 		if (err)
@@ -471,6 +885,53 @@ static inline u32 get_cstate_hint(void)
 	return target_cstate - 1;
 }
 
+static void calculate_mwait_hint(void)
+{
+	if (mwait_hint == NULL)
+	{
+		calculated_mwait_hint = 0x0;
+		calculated_mwait_hint += target_subcstate & MWAIT_SUBSTATE_MASK;
+		calculated_mwait_hint += (get_cstate_hint() & MWAIT_CSTATE_MASK) << MWAIT_SUBSTATE_SIZE;
+	}
+	else if (kstrtou32(mwait_hint, 0, &calculated_mwait_hint))
+	{
+		calculated_mwait_hint = 0x0;
+		printk(KERN_WARNING "Interpreting mwait_hint failed, falling back to hint 0x0!\n");
+	}
+
+	printk(KERN_INFO "Using MWAIT hint 0x%x.", calculated_mwait_hint);
+
+	calculated_efficiency_mwait_hint = calculated_mwait_hint;
+	if (efficiency_mwait_hint == NULL)
+		return;
+	if (kstrtou32(efficiency_mwait_hint, 0, &calculated_efficiency_mwait_hint))
+	{
+		calculated_efficiency_mwait_hint = calculated_mwait_hint;
+		printk(KERN_WARNING "Interpreting efficiency_mwait_hint failed, falling back to hint 0x%x!\n", calculated_mwait_hint);
+	}
+	printk(KERN_INFO "Using MWAIT hint 0x%x on the E-cores.", calculated_efficiency_mwait_hint);
+}
+
+// the kernel sets IA32_UMWAIT_CONTROL for user space, it is restored after the measurements
+static DEFINE_PER_CPU(u64, umwait_control_backup);
+
+static void per_cpu_set_umwait_control(void *info)
+{
+	int this_cpu = smp_processor_id();
+
+	if (rdmsrl_safe(MSR_IA32_UMWAIT_CONTROL, &per_cpu(umwait_control_backup, this_cpu)) ||
+	    wrmsrl_safe(MSR_IA32_UMWAIT_CONTROL, umwait_max_time & MSR_IA32_UMWAIT_CONTROL_TIME_MASK))
+		printk(KERN_WARNING "WARNING: Could not set IA32_UMWAIT_CONTROL on CPU %i.\n", this_cpu);
+}
+
+static void per_cpu_restore_umwait_control(void *info)
+{
+	int this_cpu = smp_processor_id();
+
+	if (wrmsrl_safe(MSR_IA32_UMWAIT_CONTROL, per_cpu(umwait_control_backup, this_cpu)))
+		printk(KERN_WARNING "WARNING: Could not restore IA32_UMWAIT_CONTROL on CPU %i.\n", this_cpu);
+}
+
 // Model and Family calculation as specified in the Intel Software Developer's Manual
 static void set_cpu_info(u32 a)
 {
@@ -490,6 +951,28 @@ static void set_cpu_info(u32 a)
 	}
 }
 
+static void per_cpu_detect_core_type(void *info)
+{
+	u32 a = CPUID_HYBRID_LEAF, b, c = 0, d;
+	int this_cpu = smp_processor_id();
+
+	asm("cpuid;"
+	    : "=a"(a), "=b"(b), "=c"(c), "=d"(d)
+	    : "0"(a), "2"(c));
+	switch (a >> CPUID_CORE_TYPE_SHIFT)
+	{
+	case CPUID_CORE_TYPE_CORE:
+		per_cpu(cpu_core_type, this_cpu) = CORE_TYPE_PERFORMANCE;
+		break;
+	case CPUID_CORE_TYPE_ATOM:
+		per_cpu(cpu_core_type, this_cpu) = CORE_TYPE_EFFICIENCY;
+		break;
+	default:
+		per_cpu(cpu_core_type, this_cpu) = CORE_TYPE_UNKNOWN;
+		break;
+	}
+}
+
 void preliminary_checks(void)
 {
 	u32 a = 0x1, b, c, d;
@@ -511,6 +994,7 @@ void preliminary_checks(void)
 	{
 		printk(KERN_WARNING "WARNING: Mwait Power Management not supported.\n");
 	}
+	mwait_interrupt_break = c & CPUID5_ECX_INTERRUPT_BREAK;
 
 	a = 0x80000007;
 	asm("cpuid;"
@@ -540,6 +1024,18 @@ void preliminary_checks(void)
 		vendor = X86_VENDOR_UNKNOWN;
 		printk(KERN_INFO "VENDOR UNKNOWN\n");
 	}
+
+	// the core type can only be read on the CPU itself
+	if (boot_cpu_has(X86_FEATURE_HYBRID_CPU))
+	{
+		on_each_cpu_mask(&measured_cpus, per_cpu_detect_core_type, NULL, 1);
+		printk(KERN_INFO "HYBRID CPU\n");
+	}
+}
+
+enum core_type get_core_type(int cpu)
+{
+	return per_cpu(cpu_core_type, cpu);
 }
 
 // Get the unit of the PKG_ENERGY_STATUS MSR in 0.1 microJoule
@@ -576,10 +1072,6 @@ void disable_percpu_interrupts(int this_cpu)
 	}
 }
 
-#define APIC_LVT_TIMER_MODE_ONESHOT (0x0)
-#define APIC_LVT_TIMER_MODE_PERIODIC (1 << 17)
-#define APIC_LVT_TIMER_MODE_TSC_DEADLINE (1 << 18)
-
 void enable_percpu_interrupts(int this_cpu)
 {
 	u32 value;
@@ -591,10 +1083,12 @@ void enable_percpu_interrupts(int this_cpu)
 
 	// Restart the timer appropriately
 	// Necessary so the system continues working properly
+	// Except in periodic mode, the timer fires right away, which is not interference
 	value = apic_read(APIC_LVTT);
 	if ((value & APIC_LVT_TIMER_MODE_MASK) == APIC_LVT_TIMER_MODE_ONESHOT)
 	{
 		apic_write(APIC_TMICT, 1);
+		per_cpu(expected_interrupts, this_cpu) += 1;
 	}
 	else if ((value & APIC_LVT_TIMER_MODE_MASK) == APIC_LVT_TIMER_MODE_PERIODIC)
 	{
@@ -604,6 +1098,8 @@ void enable_percpu_interrupts(int this_cpu)
 	{
 		if (wrmsrl_safe(MSR_IA32_TSC_DEADLINE, rdtsc()))
 			printk(KERN_WARNING "Error when trying to restart Local APIC Timer on CPU %i!\n", this_cpu);
+		else
+			per_cpu(expected_interrupts, this_cpu) += 1;
 	}
 }
 
@@ -612,13 +1108,114 @@ inline enum entry_mechanism get_signal_low_mechanism(void)
 	return ENTRY_MECHANISM_MWAIT;
 }
 
+// CPUID leaf 5 EDX holds the number of sub-states supported with MWAIT for C0 to C7 in 4 bits each
+#define CPUID_MWAIT_CSTATES (8)
+#define CPUID_MWAIT_SUBSTATES_MASK (0xf)
+
+unsigned get_entry_hints(u64 *hints, unsigned max)
+{
+	u32 a = 0x0, b, c, d;
+	unsigned cstate, substate, count = 0;
+	u32 cstate_hint;
+
+	asm("cpuid;"
+	    : "=a"(a), "=b"(b), "=c"(c), "=d"(d)
+	    : "0"(a));
+	if (a < 0x5)
+		return 0;
+
+	a = 0x5;
+	asm("cpuid;"
+	    : "=a"(a), "=b"(b), "=c"(c), "=d"(d)
+	    : "0"(a));
+	// the sub-states are only enumerated if ECX bit 0 is set
+	if (!(c & 1))
+		return 0;
+
+	for (cstate = 0; cstate < CPUID_MWAIT_CSTATES; ++cstate)
+	{
+		// C0 is requested with the C-state field 0xf, C1 with 0x0 and so on
+		cstate_hint = cstate == 0 ? MWAIT_CSTATE_MASK : cstate - 1;
+		for (substate = 0; substate < ((d >> (4 * cstate)) & CPUID_MWAIT_SUBSTATES_MASK) && count < max; ++substate)
+			hints[count++] = (cstate_hint << MWAIT_SUBSTATE_SIZE) | substate;
+	}
+	return count;
+}
+
+// the last cache level the kernel knows of is the last level cache, on AMD the L3 of a CCX
+const struct cpumask *get_llc_cpumask(int cpu)
+{
+	struct cpu_cacheinfo *info = get_cpu_cacheinfo(cpu);
+
+	if (!info || !info->info_list || info->num_leaves == 0)
+		return cpumask_of(cpu);
+	return &info->info_list[info->num_leaves - 1].shared_cpu_map;
+}
+
+// RAPL and the Package C-state residencies count for the whole package
+const struct cpumask *get_package_counter_scope(int cpu)
+{
+	return topology_core_cpumask(cpu);
+}
+
+static const char *intel_package_level_counters[] = {"energy_consumption", "c2", "c3", "c6", "c7", NULL};
+static const char *amd_package_level_counters[] = {"energy_consumption", NULL};
+
+const char **get_package_level_counters(void)
+{
+	return vendor == X86_VENDOR_INTEL ? intel_package_level_counters : amd_package_level_counters;
+}
+
+// the interrupts the kernel counts for /proc/interrupts, except for the rarely occurring error and platform vectors
+// the wakeups use the vector of irq_work, which is not counted either
+u64 get_interrupt_count(int cpu)
+{
+	u64 count = kstat_cpu_irqs_sum(cpu) + per_cpu(irq_stat, cpu).apic_timer_irqs;
+
+#ifdef CONFIG_SMP
+	count += per_cpu(irq_stat, cpu).irq_resched_count + per_cpu(irq_stat, cpu).irq_call_count;
+#endif
+#ifdef CONFIG_X86_THERMAL_VECTOR
+	count += per_cpu(irq_stat, cpu).irq_thermal_count;
+#endif
+	return count - per_cpu(expected_interrupts, cpu);
+}
+
+u64 get_nmi_count(int cpu)
+{
+	return per_cpu(irq_stat, cpu).__nmi_count - per_cpu(expected_nmis, cpu);
+}
+
 int prepare(void)
 {
 	int apic_id_of_leader;
 
-	register_nmi_handler(NMI_UNKNOWN, measurement_callback, NMI_FLAG_FIRST, "measurement_callback");
+	if (strcmp(timer, "TSC_DEADLINE") == 0)
+	{
+		if (!boot_cpu_has(X86_FEATURE_TSC_DEADLINE_TIMER))
+		{
+			printk(KERN_ERR "TSC deadline timer not supported, aborting!\n");
+			return 1;
+		}
+		window_timer = WINDOW_TIMER_TSC_DEADLINE;
+		printk(KERN_INFO "Using TSC deadline timer to end measurements.\n");
+		return 0;
+	}
+	else if (strcmp(timer, "HPET") != 0)
+	{
+		window_timer = WINDOW_TIMER_UNKNOWN;
+		printk(KERN_ERR "Timer '%s' unknown, aborting!\n", timer);
+		return 1;
+	}
+	window_timer = WINDOW_TIMER_HPET;
 
-	apic_id_of_leader = default_cpu_present_to_apicid(0);
+	if (!hpet_timer_available())
+	{
+		printk(KERN_ERR "HPET timer requires the linuxMWAIT kernel, use timer=TSC_DEADLINE instead. Aborting!\n");
+		return 1;
+	}
+
+	apic_id_of_leader = per_cpu(x86_cpu_to_apicid, get_leader_cpu());
 
 	hpet_period = get_hpet_period();
 	hpet_pin = select_hpet_pin();
@@ -629,40 +1226,57 @@ int prepare(void)
 	}
 	printk(KERN_INFO "Using IOAPIC pin %i for HPET.\n", hpet_pin);
 
+	register_nmi_handler(NMI_UNKNOWN, measurement_callback, NMI_FLAG_FIRST, "measurement_callback");
 	setup_ioapic_for_measurement(apic_id_of_leader, hpet_pin);
 
 	return 0;
 }
 
-int prepare_measurements(void)
+static int set_entry_mechanism(const char *name, enum entry_mechanism *mechanism)
 {
-	on_each_cpu(per_cpu_init, NULL, 1);
-
-	printk(KERN_INFO "Using C-State entry mechanism '%s'.", entry_mechanism);
-	if (strcmp(entry_mechanism, "POLL") == 0)
+	if (strcmp(name, "POLL") == 0)
+	{
+		*mechanism = ENTRY_MECHANISM_POLL;
+	}
+	else if (strcmp(name, "MWAIT") == 0)
 	{
-		requested_entry_mechanism = ENTRY_MECHANISM_POLL;
+		*mechanism = ENTRY_MECHANISM_MWAIT;
 	}
-	else if (strcmp(entry_mechanism, "MWAIT") == 0)
+	else if (strcmp(name, "MWAITX") == 0)
 	{
-		requested_entry_mechanism = ENTRY_MECHANISM_MWAIT;
-		if (mwait_hint == NULL)
+		*mechanism = ENTRY_MECHANISM_MWAITX;
+		if (!boot_cpu_has(X86_FEATURE_MWAITX))
 		{
-			calculated_mwait_hint = 0x0;
-			calculated_mwait_hint += target_subcstate & MWAIT_SUBSTATE_MASK;
-			calculated_mwait_hint += (get_cstate_hint() & MWAIT_CSTATE_MASK) << MWAIT_SUBSTATE_SIZE;
+			printk(KERN_ERR "MWAITX not supported, aborting!\n");
+			return 1;
 		}
-		else if (kstrtou32(mwait_hint, 0, &calculated_mwait_hint))
+		if (mwaitx_timer)
+			printk(KERN_INFO "Ending every MWAITX after %i cycles.\n", mwaitx_timer);
+	}
+	else if (strcmp(name, "HLT") == 0)
+	{
+		*mechanism = ENTRY_MECHANISM_HLT;
+	}
+	else if (strcmp(name, "UMWAIT") == 0 || strcmp(name, "TPAUSE") == 0)
+	{
+		*mechanism = strcmp(name, "UMWAIT") == 0 ? ENTRY_MECHANISM_UMWAIT : ENTRY_MECHANISM_TPAUSE;
+		if (!boot_cpu_has(X86_FEATURE_WAITPKG))
 		{
-			calculated_mwait_hint = 0x0;
-			printk(KERN_WARNING "Interpreting mwait_hint failed, falling back to hint 0x0!\n");
+			printk(KERN_ERR "%s requires WAITPKG, which is not supported, aborting!\n", name);
+			return 1;
 		}
-
-		printk(KERN_INFO "Using MWAIT hint 0x%x.", calculated_mwait_hint);
+		if (wait_state != 1 && wait_state != 2)
+		{
+			printk(KERN_ERR "Wait state C0.%i unknown, aborting!\n", wait_state);
+			return 1;
+		}
+		// bit 0 of ecx selects C0.1
+		calculated_wait_state = wait_state == 1 ? 1 : 0;
+		printk(KERN_INFO "Requesting C0.%i.\n", wait_state);
 	}
-	else if (strcmp(entry_mechanism, "IOPORT") == 0)
+	else if (strcmp(name, "IOPORT") == 0)
 	{
-		requested_entry_mechanism = ENTRY_MECHANISM_IOPORT;
+		*mechanism = ENTRY_MECHANISM_IOPORT;
 
 		if (!io_port)
 		{
@@ -682,10 +1296,63 @@ int prepare_measurements(void)
 	}
 	else
 	{
-		requested_entry_mechanism = ENTRY_MECHANISM_UNKNOWN;
-		printk(KERN_ERR "C-State entry mechanism '%s' unknown, aborting!\n", entry_mechanism);
+		*mechanism = ENTRY_MECHANISM_UNKNOWN;
+		printk(KERN_ERR "C-State entry mechanism '%s' unknown, aborting!\n", name);
 		return 1;
 	}
+	return 0;
+}
+
+static bool uses_entry_mechanism(enum entry_mechanism mechanism)
+{
+	return requested_entry_mechanism == mechanism || efficiency_requested_entry_mechanism == mechanism;
+}
+
+// everything that can fail is checked before any register is changed, cleanup_measurements() restores them
+int prepare_measurements(void)
+{
+	unsigned cpu;
+
+	if (calculate_pkg_cst_config())
+		return 1;
+
+	printk(KERN_INFO "Using C-State entry mechanism '%s'.", entry_mechanism);
+	if (set_entry_mechanism(entry_mechanism, &requested_entry_mechanism))
+		return 1;
+
+	efficiency_requested_entry_mechanism = requested_entry_mechanism;
+	if (efficiency_entry_mechanism)
+	{
+		if (!is_hybrid())
+		{
+			printk(KERN_ERR "efficiency_entry_mechanism requires a hybrid CPU, aborting!\n");
+			return 1;
+		}
+		printk(KERN_INFO "Using C-State entry mechanism '%s' on the E-cores.", efficiency_entry_mechanism);
+		if (set_entry_mechanism(efficiency_entry_mechanism, &efficiency_requested_entry_mechanism))
+			return 1;
+	}
+
+	// the leader relies on its pending timer interrupt ending MWAIT
+	if (window_timer == WINDOW_TIMER_TSC_DEADLINE && get_requested_entry_mechanism(get_leader_cpu()) == ENTRY_MECHANISM_MWAIT &&
+	    !mwait_interrupt_break)
+	{
+		printk(KERN_ERR "TSC deadline timer requires interrupts to end MWAIT while disabled, which is not supported, aborting!\n");
+		return 1;
+	}
+
+	if (vendor == X86_VENDOR_INTEL)
+		prepare_thermal();
+	if (cooldown_temperature && !thermal_available())
+	{
+		printk(KERN_ERR "Waiting for the package to cool down requires the thermal sensors of Intel CPUs, aborting!\n");
+		return 1;
+	}
+
+	if (uses_entry_mechanism(ENTRY_MECHANISM_MWAIT) || uses_entry_mechanism(ENTRY_MECHANISM_MWAITX))
+		calculate_mwait_hint();
+	for_each_cpu(cpu, &measured_cpus)
+		per_cpu(cpu_mwait_hint, cpu) = get_entry_hint(cpu);
 
 	if (vendor == X86_VENDOR_AMD)
 	{
@@ -701,16 +1368,60 @@ int prepare_measurements(void)
 	rapl_unit = get_rapl_unit();
 	printk(KERN_INFO "RAPL Unit in 0.1 microJoule: %u\n", rapl_unit);
 
+	on_each_cpu_mask(&measured_cpus, per_cpu_backup_pkg_cst_config, NULL, 1);
+	on_each_cpu_mask(&measured_cpus, per_cpu_init, NULL, 1);
+
+	if ((uses_entry_mechanism(ENTRY_MECHANISM_UMWAIT) || uses_entry_mechanism(ENTRY_MECHANISM_TPAUSE)) && umwait_max_time >= 0)
+		on_each_cpu_mask(&measured_cpus, per_cpu_set_umwait_control, NULL, 1);
+
 	return 0;
 }
 
+// the leader keeps the timer ending the windows, the other CPUs use their Local APIC timers for the idle periods
+int prepare_replay(void)
+{
+	// E-cores polling instead are handled by do_system_specific_idle() as well
+	if (requested_entry_mechanism != ENTRY_MECHANISM_MWAIT ||
+	    (efficiency_requested_entry_mechanism != ENTRY_MECHANISM_MWAIT && efficiency_requested_entry_mechanism != ENTRY_MECHANISM_POLL))
+	{
+		printk(KERN_ERR "Timed idle periods ('replay' and 'periodic' mode) are only supported with 'MWAIT', aborting!\n");
+		return 1;
+	}
+	if (!boot_cpu_has(X86_FEATURE_TSC_DEADLINE_TIMER))
+	{
+		printk(KERN_ERR "TSC deadline timer not supported, aborting!\n");
+		return 1;
+	}
+	if (!mwait_interrupt_break)
+	{
+		printk(KERN_ERR "Timed idle periods require interrupts to end MWAIT while disabled, which is not supported, aborting!\n");
+		return 1;
+	}
+	return 0;
+}
+
+u64 get_entry_hint(int cpu)
+{
+	return get_core_type(cpu) == CORE_TYPE_EFFICIENCY ? calculated_efficiency_mwait_hint : calculated_mwait_hint;
+}
+
+enum entry_mechanism get_requested_entry_mechanism(int cpu)
+{
+	return get_core_type(cpu) == CORE_TYPE_EFFICIENCY ? efficiency_requested_entry_mechanism : requested_entry_mechanism;
+}
+
 void cleanup_measurements(void)
 {
-	on_each_cpu(per_cpu_cleanup, NULL, 1);
+	on_each_cpu_mask(&measured_cpus, per_cpu_cleanup, NULL, 1);
+	if ((uses_entry_mechanism(ENTRY_MECHANISM_UMWAIT) || uses_entry_mechanism(ENTRY_MECHANISM_TPAUSE)) && umwait_max_time >= 0)
+		on_each_cpu_mask(&measured_cpus, per_cpu_restore_umwait_control, NULL, 1);
 }
 
 void cleanup(void)
 {
+	// only the HPET ends the windows with an NMI, prepare() registers the handler for nothing else
+	if (window_timer != WINDOW_TIMER_HPET)
+		return;
 	restore_ioapic_after_measurement();
 	unregister_nmi_handler(NMI_UNKNOWN, "measurement_callback");
 }
@@ -1,4 +1,7 @@
 #include "sysfs.h"
+#include "thermal.h"
+
+#include <linux/cpumask.h>
 
 struct pkg_stat pkg_stats;
 struct cpu_stat cpu_stats[MAX_CPUS];
@@ -11,17 +14,75 @@ create_attribute(pkg, c2);
 create_attribute(pkg, c3);
 create_attribute(pkg, c6);
 create_attribute(pkg, c7);
-static struct attribute *pkg_stats_attributes[16] = {
+create_attribute(pkg, smis);
+create_attribute(pkg, pkg_cst_config);
+create_attribute(pkg, temperature_start);
+create_attribute(pkg, temperature_end);
+create_attribute(pkg, throttled);
+create_attribute(pkg, throttle_time);
+create_attribute(pkg, power_limit);
+create_attribute(pkg, tcc_offset);
+create_attribute(pkg, cooldown_time);
+static struct attribute *pkg_stats_attributes[] = {
     &start_time_attribute,
     &end_time_attribute,
     &repetitions_attribute,
+    &interfered_attribute,
+    &measured_cpus_attribute,
+    &contaminating_cpus_attribute,
+    &contaminated_counters_attribute,
     &pkg_energy_consumption_attribute,
     &pkg_total_tsc_attribute,
     NULL};
 static struct attribute_group pkg_stats_group = {
     .attrs = pkg_stats_attributes};
+
+static umode_t intel_stats_visible(struct kobject *kobj, struct attribute *attr, int index)
+{
+	return vendor == X86_VENDOR_INTEL ? attr->mode : 0;
+}
+
+static umode_t thermal_stats_visible(struct kobject *kobj, struct attribute *attr, int index)
+{
+	return vendor == X86_VENDOR_INTEL && thermal_available() ? attr->mode : 0;
+}
+
+static umode_t amd_stats_visible(struct kobject *kobj, struct attribute *attr, int index)
+{
+	return vendor == X86_VENDOR_AMD ? attr->mode : 0;
+}
+
+static struct attribute *intel_pkg_stats_attributes[] = {
+    &pkg_c2_attribute,
+    &pkg_c3_attribute,
+    &pkg_c6_attribute,
+    &pkg_c7_attribute,
+    &pkg_smis_attribute,
+    &pkg_pkg_cst_config_attribute,
+    NULL};
+static struct attribute_group intel_pkg_stats_group = {
+    .is_visible = intel_stats_visible,
+    .attrs = intel_pkg_stats_attributes};
+
+static struct attribute *thermal_pkg_stats_attributes[] = {
+    &pkg_temperature_start_attribute,
+    &pkg_temperature_end_attribute,
+    &pkg_throttled_attribute,
+    &pkg_throttle_time_attribute,
+    &pkg_power_limit_attribute,
+    &pkg_tcc_offset_attribute,
+    &pkg_cooldown_time_attribute,
+    NULL};
+static struct attribute_group thermal_pkg_stats_group = {
+    .is_visible = thermal_stats_visible,
+    .attrs = thermal_pkg_stats_attributes};
+
 static const struct attribute_group *pkg_stats_groups[] = {
     &pkg_stats_group,
+    &intel_pkg_stats_group,
+    &thermal_pkg_stats_group,
+    &selection_stats_group,
+    &hybrid_stats_group,
     NULL};
 
 create_attribute(cpu, energy_consumption);
@@ -29,14 +90,49 @@ create_attribute(cpu, unhalted);
 create_attribute(cpu, c3);
 create_attribute(cpu, c6);
 create_attribute(cpu, c7);
-static struct attribute *cpu_stats_attributes[16] = {
+create_attribute(cpu, temperature);
+create_attribute(cpu, throttled);
+static struct attribute *cpu_stats_attributes[] = {
     &cpu_wakeup_time_attribute,
     &cpu_wakeups_attribute,
+    &cpu_interrupts_attribute,
+    &cpu_nmis_attribute,
     NULL};
 static struct attribute_group cpu_stats_group = {
     .attrs = cpu_stats_attributes};
+
+static struct attribute *intel_cpu_stats_attributes[] = {
+    &cpu_unhalted_attribute,
+    &cpu_c3_attribute,
+    &cpu_c6_attribute,
+    &cpu_c7_attribute,
+    NULL};
+static struct attribute_group intel_cpu_stats_group = {
+    .is_visible = intel_stats_visible,
+    .attrs = intel_cpu_stats_attributes};
+
+static struct attribute *thermal_cpu_stats_attributes[] = {
+    &cpu_temperature_attribute,
+    &cpu_throttled_attribute,
+    NULL};
+static struct attribute_group thermal_cpu_stats_group = {
+    .is_visible = thermal_stats_visible,
+    .attrs = thermal_cpu_stats_attributes};
+
+static struct attribute *amd_cpu_stats_attributes[] = {
+    &cpu_energy_consumption_attribute,
+    NULL};
+static struct attribute_group amd_cpu_stats_group = {
+    .is_visible = amd_stats_visible,
+    .attrs = amd_cpu_stats_attributes};
+
 static const struct attribute_group *cpu_stats_groups[] = {
     &cpu_stats_group,
+    &intel_cpu_stats_group,
+    &thermal_cpu_stats_group,
+    &amd_cpu_stats_group,
+    &refill_stats_group,
+    &core_type_stats_group,
     NULL};
 
 ssize_t output_pkg_attributes(struct pkg_stat *stat, struct attribute *attr, char *buf)
@@ -47,6 +143,15 @@ ssize_t output_pkg_attributes(struct pkg_stat *stat, struct attribute *attr, cha
 	output_to_sysfs(c3, measurement_count);
 	output_to_sysfs(c6, measurement_count);
 	output_to_sysfs(c7, measurement_count);
+	output_to_sysfs(smis, measurement_count);
+	output_to_sysfs(pkg_cst_config, measurement_count);
+	output_to_sysfs(temperature_start, measurement_count);
+	output_to_sysfs(temperature_end, measurement_count);
+	output_to_sysfs(throttled, measurement_count);
+	output_to_sysfs(throttle_time, measurement_count);
+	output_to_sysfs(power_limit, measurement_count);
+	output_to_sysfs(tcc_offset, measurement_count);
+	output_to_sysfs(cooldown_time, measurement_count);
 	return 0;
 }
 
@@ -57,6 +162,8 @@ ssize_t output_cpu_attributes(struct cpu_stat *stat, struct attribute *attr, cha
 	output_to_sysfs(c3, measurement_count);
 	output_to_sysfs(c6, measurement_count);
 	output_to_sysfs(c7, measurement_count);
+	output_to_sysfs(temperature, measurement_count);
+	output_to_sysfs(throttled, measurement_count);
 	return 0;
 }
 
@@ -75,45 +182,15 @@ static const struct kobj_type cpu_ktype = {
     .release = release,
     .default_groups = cpu_stats_groups};
 
-extern unsigned cpus_present;
+extern struct cpumask measured_cpus;
 
 void publish_measurement_results(void)
 {
 	int err;
-
-	if (vendor == X86_VENDOR_INTEL)
-	{
-		pkg_stats_attributes[5] = &pkg_c2_attribute;
-		pkg_stats_attributes[6] = &pkg_c3_attribute;
-		pkg_stats_attributes[7] = &pkg_c6_attribute;
-		pkg_stats_attributes[8] = &pkg_c7_attribute;
-		pkg_stats_attributes[9] = NULL;
-	}
-	else
-	{
-		pkg_stats_attributes[5] = NULL;
-	}
-
-	if (vendor == X86_VENDOR_INTEL)
-	{
-		cpu_stats_attributes[2] = &cpu_unhalted_attribute;
-		cpu_stats_attributes[3] = &cpu_c3_attribute;
-		cpu_stats_attributes[4] = &cpu_c6_attribute;
-		cpu_stats_attributes[5] = &cpu_c7_attribute;
-		cpu_stats_attributes[6] = NULL;
-	}
-	else if (vendor == X86_VENDOR_AMD)
-	{
-		cpu_stats_attributes[2] = &cpu_energy_consumption_attribute;
-		cpu_stats_attributes[3] = NULL;
-	}
-	else
-	{
-		cpu_stats_attributes[2] = NULL;
-	}
+	unsigned i;
 
 	err = kobject_init_and_add(&(pkg_stats.kobject), &pkg_ktype, NULL, "mwait_measurements");
-	for (unsigned i = 0; i < cpus_present; ++i)
+	for_each_cpu(i, &measured_cpus)
 	{
 		err |= kobject_init_and_add(&(cpu_stats[i].kobject), &cpu_ktype, &(pkg_stats.kobject), "cpu%u", i);
 	}
@@ -123,7 +200,9 @@ void publish_measurement_results(void)
 
 void cleanup_measurement_results(void)
 {
-	for (unsigned i = 0; i < cpus_present; ++i)
+	unsigned i;
+
+	for_each_cpu(i, &measured_cpus)
 	{
 		kobject_del(&(cpu_stats[i].kobject));
 	}
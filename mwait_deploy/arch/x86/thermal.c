@@ -0,0 +1,159 @@
+#include "thermal.h"
+#include "measure.h"
+#include "sysfs.h"
+
+#include <linux/kernel.h>
+#include <linux/delay.h>
+#include <linux/cpumask.h>
+#include <asm/msr.h>
+#include <asm/cpufeature.h>
+#include <asm/msr-index.h>
+
+// Intel only, the sensors report temperatures as distance to TjMax in degrees Celsius.
+// Rising temperatures over a long campaign, as well as throttling and power limits kicking in, explain drift of the energy values.
+// Published units: degrees Celsius, throttle_time in microseconds, power_limit in milliWatt, cooldown_time in milliseconds.
+
+#define THERM_STATUS_THROTTLED (1 << 0)
+#define THERM_STATUS_THROTTLED_LOG (1 << 1)
+#define THERM_STATUS_POWER_LIMITED (1 << 10)
+#define THERM_STATUS_POWER_LIMITED_LOG (1 << 11)
+// the sticky log bits are cleared by writing 0, writing 1 leaves them unchanged
+#define THERM_STATUS_LOG_MASK (0xaaaa)
+#define THERM_STATUS_THROTTLING (THERM_STATUS_THROTTLED | THERM_STATUS_POWER_LIMITED)
+#define THERM_STATUS_THROTTLING_LOG (THERM_STATUS_THROTTLED_LOG | THERM_STATUS_POWER_LIMITED_LOG)
+#define THERM_STATUS_READOUT(status) (((status) >> 16) & 0x7f)
+#define TEMPERATURE_TARGET_TJ_MAX(target) (((target) >> 16) & 0xff)
+#define TEMPERATURE_TARGET_TCC_OFFSET(target) (((target) >> 24) & 0x3f)
+#define POWER_LIMIT_PL1(limit) ((limit) & 0x7fff)
+
+#define COOLDOWN_POLL_INTERVAL (100) // milliseconds
+
+static bool available;
+static bool perf_status_available;
+static u32 power_unit, time_unit;
+
+static u64 start_pkg_therm, final_pkg_therm;
+static u64 start_perf_status, final_perf_status;
+static u64 temperature_target, power_limit;
+static u64 cooldown_time;
+static DEFINE_PER_CPU(u64, start_therm);
+static DEFINE_PER_CPU(u64, final_therm);
+
+static inline u64 to_temperature(u64 status)
+{
+	return TEMPERATURE_TARGET_TJ_MAX(temperature_target) - THERM_STATUS_READOUT(status);
+}
+
+void prepare_thermal(void)
+{
+	u64 val;
+
+	available = boot_cpu_has(X86_FEATURE_PTS) && boot_cpu_has(X86_FEATURE_DTHERM);
+	if (!available)
+	{
+		printk(KERN_WARNING "WARNING: Package and core thermal sensors are not supported, temperatures are not recorded.\n");
+		return;
+	}
+
+	read_msr(MSR_IA32_TEMPERATURE_TARGET, &temperature_target);
+	printk(KERN_INFO "TjMax is %llu degrees Celsius, TCC offset %llu.\n",
+	       TEMPERATURE_TARGET_TJ_MAX(temperature_target), TEMPERATURE_TARGET_TCC_OFFSET(temperature_target));
+
+	read_msr(MSR_RAPL_POWER_UNIT, &val);
+	power_unit = val & 0xf;
+	time_unit = (val >> 16) & 0xf;
+
+	// only some models count the time the package was throttled by RAPL
+	perf_status_available = !rdmsrl_safe(MSR_PKG_PERF_STATUS, &val);
+}
+
+bool thermal_available(void)
+{
+	return available;
+}
+
+// The status bits only tell whether the CPU is throttled right now, so the log bits recording any throttling are cleared at the start of a window
+// Leaves the other log bits unchanged, like the kernel does, which clears them as well when handling thermal interrupts
+static void clear_throttling_log(u32 msr, u64 status)
+{
+	if (wrmsrl_safe(msr, status & THERM_STATUS_LOG_MASK & ~THERM_STATUS_THROTTLING_LOG))
+		printk_once(KERN_WARNING "WARNING: Could not clear the throttling log of register %u.\n", msr);
+}
+
+void set_thermal_start_values(void)
+{
+	read_msr(MSR_IA32_PACKAGE_THERM_STATUS, &start_pkg_therm);
+	clear_throttling_log(MSR_IA32_PACKAGE_THERM_STATUS, start_pkg_therm);
+	if (perf_status_available)
+		read_msr(MSR_PKG_PERF_STATUS, &start_perf_status);
+}
+
+void set_cpu_thermal_start_values(int this_cpu)
+{
+	read_msr(MSR_IA32_THERM_STATUS, &per_cpu(start_therm, this_cpu));
+	clear_throttling_log(MSR_IA32_THERM_STATUS, per_cpu(start_therm, this_cpu));
+}
+
+void set_thermal_final_values(void)
+{
+	read_msr(MSR_IA32_PACKAGE_THERM_STATUS, &final_pkg_therm);
+	if (perf_status_available)
+		read_msr(MSR_PKG_PERF_STATUS, &final_perf_status);
+	read_msr(MSR_PKG_POWER_LIMIT, &power_limit);
+	read_msr(MSR_IA32_TEMPERATURE_TARGET, &temperature_target);
+}
+
+void set_cpu_thermal_final_values(int this_cpu)
+{
+	read_msr(MSR_IA32_THERM_STATUS, &per_cpu(final_therm, this_cpu));
+}
+
+// throttled during the window if it was at its start or is logged since
+static inline bool was_throttled(u64 start_status, u64 final_status)
+{
+	return (start_status & THERM_STATUS_THROTTLING) || (final_status & (THERM_STATUS_THROTTLING | THERM_STATUS_THROTTLING_LOG));
+}
+
+void commit_thermal_results(unsigned number)
+{
+	unsigned i;
+
+	pkg_stats.attributes.temperature_start[number] = to_temperature(start_pkg_therm);
+	pkg_stats.attributes.temperature_end[number] = to_temperature(final_pkg_therm);
+	pkg_stats.attributes.throttled[number] = was_throttled(start_pkg_therm, final_pkg_therm);
+	// the counter wraps at 32 bits, its unit is the RAPL time unit
+	pkg_stats.attributes.throttle_time[number] = ((((final_perf_status - start_perf_status) & 0xffffffff) * 1000000) >> time_unit);
+	pkg_stats.attributes.power_limit[number] = (POWER_LIMIT_PL1(power_limit) * 1000) >> power_unit;
+	pkg_stats.attributes.tcc_offset[number] = TEMPERATURE_TARGET_TCC_OFFSET(temperature_target);
+	pkg_stats.attributes.cooldown_time[number] = cooldown_time;
+
+	for_each_cpu(i, &measured_cpus)
+	{
+		cpu_stats[i].attributes.temperature[number] = to_temperature(per_cpu(final_therm, i));
+		cpu_stats[i].attributes.throttled[number] = was_throttled(per_cpu(start_therm, i), per_cpu(final_therm, i));
+	}
+}
+
+// sleeping here lets the whole system idle, which is what cools it down
+void wait_for_cooldown(int cpu, int target_temperature, int timeout)
+{
+	u64 status;
+
+	for (cooldown_time = 0;; cooldown_time += COOLDOWN_POLL_INTERVAL)
+	{
+		if (rdmsrl_safe_on_cpu(cpu, MSR_IA32_PACKAGE_THERM_STATUS, &status))
+		{
+			rdmsr_error("MSR_IA32_PACKAGE_THERM_STATUS", MSR_IA32_PACKAGE_THERM_STATUS);
+			return;
+		}
+		if (to_temperature(status) <= target_temperature)
+			return;
+		if (cooldown_time >= timeout * 1000)
+		{
+			printk(KERN_WARNING "WARNING: Package did not cool down to %i degrees Celsius within %i s, measuring anyway.\n",
+			       target_temperature, timeout);
+			return;
+		}
+		msleep(COOLDOWN_POLL_INTERVAL);
+	}
+}
@@ -0,0 +1,82 @@
+#include "benchmark.h"
+#include "measure.h"
+#include "sysfs.h"
+
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/sched/clock.h>
+#include <asm/page.h>
+
+const char *benchmark_phase_names[BENCHMARK_PHASE_COUNT] = {
+    "sync",
+    "window_end",
+    "wakeup",
+    "cpu_snapshot",
+    "global_snapshot",
+    "format"};
+
+static u64 samples[BENCHMARK_PHASE_COUNT][MAX_BENCHMARK_ITERATIONS];
+static unsigned sample_count[BENCHMARK_PHASE_COUNT];
+
+void record_benchmark_sample(enum benchmark_phase phase, u64 ns)
+{
+	if (sample_count[phase] < MAX_BENCHMARK_ITERATIONS)
+		samples[phase][sample_count[phase]++] = ns;
+}
+
+// formats an array of realistic values the way every result is published
+void benchmark_format(void)
+{
+	u64 values[MAX_NUMBER_OF_MEASUREMENTS];
+	char *buf = kmalloc(PAGE_SIZE, GFP_KERNEL);
+	u64 stamp;
+	int i;
+
+	if (!buf)
+		return;
+
+	for (i = 0; i < MAX_NUMBER_OF_MEASUREMENTS; ++i)
+		values[i] = local_clock();
+
+	for (i = 0; i < benchmark_iterations; ++i)
+	{
+		stamp = local_clock();
+		format_array_into_buffer(values, MAX_NUMBER_OF_MEASUREMENTS, buf);
+		record_benchmark_sample(BENCHMARK_FORMAT, local_clock() - stamp);
+	}
+
+	kfree(buf);
+}
+
+static int compare_samples(const void *a, const void *b)
+{
+	u64 x = *(const u64 *)a;
+	u64 y = *(const u64 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+void evaluate_benchmark(void)
+{
+	int phase;
+
+	benchmark_stat.iterations = benchmark_iterations;
+
+	for (phase = 0; phase < BENCHMARK_PHASE_COUNT; ++phase)
+	{
+		unsigned count = sample_count[phase];
+		u64 *result = benchmark_stat.results[phase];
+
+		if (!count)
+			continue;
+
+		sort(samples[phase], count, sizeof(u64), compare_samples, NULL);
+		result[BENCHMARK_MIN] = samples[phase][0];
+		result[BENCHMARK_MEDIAN] = samples[phase][count / 2];
+		result[BENCHMARK_P99] = samples[phase][(count * 99) / 100];
+
+		printk(KERN_INFO "Benchmark %s: min %llu ns, median %llu ns, p99 %llu ns (%u samples)\n",
+		       benchmark_phase_names[phase], result[BENCHMARK_MIN], result[BENCHMARK_MEDIAN], result[BENCHMARK_P99], count);
+	}
+}
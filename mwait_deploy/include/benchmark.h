@@ -0,0 +1,33 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <linux/types.h>
+
+enum benchmark_phase
+{
+	BENCHMARK_SYNC,		   // barrier latency of the last CPU arriving
+	BENCHMARK_WINDOW_END,	   // from the timer expiring until the leader handles it
+	BENCHMARK_WAKEUP,	   // from the leader's wakeup until the last other CPU notices it
+	BENCHMARK_CPU_SNAPSHOT,	   // reading the per-CPU values, slowest CPU
+	BENCHMARK_GLOBAL_SNAPSHOT, // reading the package values
+	BENCHMARK_FORMAT,	   // formatting one result array for the sysfs
+	BENCHMARK_PHASE_COUNT
+};
+
+// published for every phase, in nanoseconds
+enum benchmark_statistic
+{
+	BENCHMARK_MIN,
+	BENCHMARK_MEDIAN,
+	BENCHMARK_P99,
+	BENCHMARK_STATISTIC_COUNT
+};
+
+extern const char *benchmark_phase_names[BENCHMARK_PHASE_COUNT];
+extern int benchmark_iterations;
+
+void record_benchmark_sample(enum benchmark_phase phase, u64 ns);
+void benchmark_format(void);
+void evaluate_benchmark(void);
+
+#endif
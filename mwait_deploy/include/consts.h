@@ -4,6 +4,24 @@
 #define MAX_NUMBER_OF_MEASUREMENTS (100)
 #define MAX_CPUS (32)
 
-#define SIGNAL_EDGE_COUNT (3)
+// the timestamps of all levels have to fit into a single sysfs page
+#define MAX_SIGNAL_ORDER (7)
+#define MAX_SIGNAL_LEVELS ((1 << MAX_SIGNAL_ORDER) - 1)
+
+#define MAX_BENCHMARK_ITERATIONS (10000)
+
+// 8 C-states with 16 sub-states each, as enumerated by CPUID leaf 5 on x86
+#define MAX_ENTRY_HINTS (128)
+
+// idle states a trace may refer to, and the largest trace file, 64 MiB are about 2.8 million idle periods
+#define MAX_REPLAY_STATES (16)
+#define MAX_REPLAY_FILE_SIZE (64 << 20)
+
+// periodic wakeups per second and CPU, faster ones mostly measure the exit latency
+#define MAX_WAKEUP_RATE (100000)
+
+// largest working set per CPU in KiB, touched in units of a cache line
+#define MAX_WORKING_SET (1 << 20)
+#define WORKING_SET_LINE_SIZE (64)
 
 #endif
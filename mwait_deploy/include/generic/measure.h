@@ -3,26 +3,46 @@
 
 #include <linux/types.h>
 #include <linux/percpu.h>
+#include <linux/cpumask.h>
 
 enum mode
 {
 	MODE_UNKNOWN,
 	MODE_MEASURE,
-	MODE_SIGNAL
+	MODE_SIGNAL,
+	MODE_BENCHMARK,
+	MODE_DISCOVER,
+	MODE_REPLAY,
+	MODE_PERIODIC
 };
 extern enum mode operation_mode;
 
+// the core types of hybrid CPUs like Alder Lake, or big.LITTLE on ARM
+enum core_type
+{
+	CORE_TYPE_UNKNOWN,
+	CORE_TYPE_PERFORMANCE,
+	CORE_TYPE_EFFICIENCY
+};
+
 extern int duration;
 extern enum entry_mechanism requested_entry_mechanism;
 DECLARE_PER_CPU(enum entry_mechanism, cpu_entry_mechanism);
 
 extern bool redo_measurement;
 extern unsigned cpus_present;
+extern struct cpumask measured_cpus;
+extern struct cpumask sleeping_cpus;
+extern struct cpumask contaminating_cpus;
 
 DECLARE_PER_CPU(u64, wakeups);
 DECLARE_PER_CPU(s64, wakeup_time);
+DECLARE_PER_CPU(u64, interrupts);
+DECLARE_PER_CPU(u64, nmis);
 
 bool is_leader(int cpu);
+bool is_hybrid(void);
+int get_leader_cpu(void);
 void leader_callback(void);
 void all_cpus_callback(int this_cpu);
 
@@ -47,5 +67,17 @@ void evaluate_cpu(int this_cpu);
 void disable_percpu_interrupts(int this_cpu);
 void enable_percpu_interrupts(int this_cpu);
 enum entry_mechanism get_signal_low_mechanism(void);
+const struct cpumask *get_package_counter_scope(int cpu);
+const struct cpumask *get_llc_cpumask(int cpu);
+const char **get_package_level_counters(void);
+u64 get_interrupt_count(int cpu);
+u64 get_nmi_count(int cpu);
+unsigned get_entry_hints(u64 *hints, unsigned max);
+int prepare_replay(void);
+u64 get_entry_hint(int cpu);
+enum entry_mechanism get_requested_entry_mechanism(int cpu);
+enum core_type get_core_type(int cpu);
+bool is_measurement_ongoing(void);
+void do_system_specific_idle(int this_cpu, enum entry_mechanism mechanism, u64 hint, u64 idle_ns);
 
 #endif
\ No newline at end of file
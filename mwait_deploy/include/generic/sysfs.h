@@ -6,6 +6,7 @@
 #endif
 
 #include "consts.h"
+#include "benchmark.h"
 
 #include <linux/kobject.h>
 #include <linux/types.h>
@@ -14,18 +15,41 @@
 extern struct signal_stat
 {
 	struct kobject kobject;
-	u64 signal_times[SIGNAL_EDGE_COUNT + 2];
+	u64 level_count;
+	u64 signal_code[MAX_SIGNAL_LEVELS];
+	u64 signal_times[MAX_SIGNAL_LEVELS + 1];
 } signal_stat;
 
 void publish_signal_times(void);
 void cleanup_signal_times(void);
 
+extern struct discovery_stat
+{
+	struct kobject kobject;
+	u64 hint_count;
+	u64 hints[MAX_ENTRY_HINTS];
+} discovery_stat;
+
+void publish_discovered_hints(void);
+void cleanup_discovered_hints(void);
+
+extern struct benchmark_stat
+{
+	struct kobject kobject;
+	u64 iterations;
+	u64 results[BENCHMARK_PHASE_COUNT][BENCHMARK_STATISTIC_COUNT];
+} benchmark_stat;
+
+void publish_benchmark_results(void);
+void cleanup_benchmark_results(void);
+
 extern struct pkg_stat
 {
 	struct kobject kobject;
 	u64 start_time[MAX_NUMBER_OF_MEASUREMENTS];
 	u64 end_time[MAX_NUMBER_OF_MEASUREMENTS];
 	u64 repetitions[MAX_NUMBER_OF_MEASUREMENTS];
+	u64 interfered[MAX_NUMBER_OF_MEASUREMENTS];
 	struct pkg_attributes attributes;
 } pkg_stats;
 
@@ -34,15 +58,32 @@ extern struct cpu_stat
 	struct kobject kobject;
 	s64 wakeup_time[MAX_NUMBER_OF_MEASUREMENTS];
 	u64 wakeups[MAX_NUMBER_OF_MEASUREMENTS];
+	u64 interrupts[MAX_NUMBER_OF_MEASUREMENTS];
+	u64 nmis[MAX_NUMBER_OF_MEASUREMENTS];
+	u64 warm_time[MAX_NUMBER_OF_MEASUREMENTS];
+	u64 refill_time[MAX_NUMBER_OF_MEASUREMENTS];
 	struct cpu_attributes attributes;
 } cpu_stats[MAX_CPUS];
 
 extern struct attribute start_time_attribute;
 extern struct attribute end_time_attribute;
 extern struct attribute repetitions_attribute;
+extern struct attribute interfered_attribute;
+extern struct attribute measured_cpus_attribute;
+extern struct attribute contaminating_cpus_attribute;
+extern struct attribute contaminated_counters_attribute;
 
 extern struct attribute cpu_wakeup_time_attribute;
 extern struct attribute cpu_wakeups_attribute;
+extern struct attribute cpu_interrupts_attribute;
+extern struct attribute cpu_nmis_attribute;
+
+// only published with a working set, see refill.c
+extern const struct attribute_group refill_stats_group;
+extern const struct attribute_group selection_stats_group;
+// only published on hybrid CPUs
+extern const struct attribute_group hybrid_stats_group;
+extern const struct attribute_group core_type_stats_group;
 
 ssize_t show_pkg_stats(struct kobject *kobj, struct attribute *attr, char *buf);
 ssize_t show_cpu_stats(struct kobject *kobj, struct attribute *attr, char *buf);
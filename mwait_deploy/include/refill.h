@@ -0,0 +1,19 @@
+#ifndef REFILL_H
+#define REFILL_H
+
+#include <linux/types.h>
+#include <linux/percpu.h>
+
+// time to traverse the working set before sleeping while it is cached and again after the wakeup, in nanoseconds
+DECLARE_PER_CPU(u64, warm_time);
+DECLARE_PER_CPU(u64, refill_time);
+
+extern int working_set;
+
+bool is_refilling(void);
+int prepare_working_sets(void);
+void free_working_sets(void);
+void warm_working_set(int this_cpu);
+void refill_working_set(int this_cpu);
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "measure.h"
+#include "consts.h"
+
+#include <linux/types.h>
+
+// Idle trace file, little-endian: the header followed by record_count records, see scripts/convertIdleTrace.py
+#define REPLAY_MAGIC "MWREPLAY"
+#define REPLAY_VERSION (1)
+
+struct replay_header
+{
+	char magic[8];
+	u32 version;
+	u32 record_size;
+	u64 record_count;
+};
+
+// an idle period of a CPU and the busy period following it
+struct replay_record
+{
+	u32 cpu;
+	u32 state; // index of the idle state, as in the cpu_idle tracepoint
+	u64 idle_ns;
+	u64 busy_ns;
+};
+
+// how an idle state of the trace is entered
+struct replay_state
+{
+	enum entry_mechanism mechanism;
+	u64 hint;
+};
+
+int load_replay_trace(void);
+void free_replay_trace(void);
+bool is_replaying(int cpu);
+void replay_trace(int this_cpu);
+int prepare_periodic_wakeups(void);
+void wake_periodically(int this_cpu);
+bool missed_periodic_wakeups(int cpu, u64 window_ns);
+
+#endif
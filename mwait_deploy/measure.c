@@ -1,44 +1,93 @@
 #include "measure.h"
 #include "sysfs.h"
+#include "benchmark.h"
+#include "replay.h"
+#include "refill.h"
 
 #include <linux/kernel.h>
 #include <linux/module.h>
 #include <linux/sched/clock.h>
+#include <linux/cpumask.h>
+#include <linux/preempt.h>
+#include <linux/topology.h>
+#include <linux/sched/topology.h>
+#include <linux/sort.h>
 
 MODULE_LICENSE("GPL");
 
 static char *mode = "measure";
 module_param(mode, charp, 0);
-MODULE_PARM_DESC(mode, "The mode the module will operate in. Supported are 'measure' and 'signal', default is 'measure'.\n"
+MODULE_PARM_DESC(mode, "The mode the module will operate in. Supported are 'measure', 'signal', 'benchmark', 'discover', 'replay' and 'periodic', default is 'measure'.\n"
 		       "In 'measure' mode, the usual measurements will be taken and published to the sysfs.\n"
 		       "In 'signal' mode, a signature will be generated in the power consumption of the device "
-		       "and only the timestamps of this signature will be published.");
+		       "and only the timestamps of this signature will be published.\n"
+		       "In 'benchmark' mode, the overhead of the measurement harness itself is measured and published.\n"
+		       "In 'discover' mode, all hints the hardware supports for entering idle states are published (MWAIT hints from CPUID on x86), together with the core types of the measured CPUs, without setting up the timer.\n"
+		       "In 'replay' mode, the measurements are taken while the CPUs replay the idle periods of a trace (see trace_file).\n"
+		       "In 'periodic' mode, the measurements are taken while the CPUs are woken up periodically (see wakeup_rate).");
 
 int duration = 100;
 module_param(duration, int, 0);
-MODULE_PARM_DESC(duration, "In 'measure' mode, the duration of each measurement.\n"
+MODULE_PARM_DESC(duration, "In 'measure', 'replay' and 'periodic' mode, the duration of each measurement.\n"
 			   "In 'signal' mode, how long the signal should stay at each level.\n"
+			   "In 'benchmark' mode, the duration of each measurement window, a short one like 1 is recommended.\n"
 			   "Unit is milliseconds. Default is 100.");
 
+static char *signal_code = "barker";
+module_param(signal_code, charp, 0);
+MODULE_PARM_DESC(signal_code, "In 'signal' mode, the sequence of high (polling) and low levels forming the signature. Supported are 'barker', 'prbs' and 'square'.\n"
+			      "'barker' is the Barker code of length 13, 'prbs' a pseudo-random maximum length sequence of 2^signal_order - 1 levels, "
+			      "both are easy to find by cross-correlation. 'square' alternates between four levels. Default is 'barker'.");
+static int signal_order = 6;
+module_param(signal_order, int, 0);
+MODULE_PARM_DESC(signal_order, "In 'signal' mode with 'prbs', the order of the sequence, between 2 and 7. Default is 6.");
+
 int measurement_count = 10;
 module_param(measurement_count, int, 0);
 MODULE_PARM_DESC(measurement_count, "How many measurements should be done. Default is 10.");
+int benchmark_iterations = 1000;
+module_param(benchmark_iterations, int, 0);
+MODULE_PARM_DESC(benchmark_iterations, "In 'benchmark' mode, how many measurement windows should be timed. Default is 1000.");
 static int cpus_sleep = -1;
 module_param(cpus_sleep, int, 0);
 MODULE_PARM_DESC(cpus_sleep, "Number of CPUs that should use the requested entry_mechanism to sleep instead of polling during the measurement.\n"
 			     "If 'POLL' was selected as entry_mechanism, this setting does nothing.\n"
 			     "By default, none of the CPUs poll.");
-static char *cpu_selection = "core";
+static char *cpu_selection = "smt";
 module_param(cpu_selection, charp, 0);
-MODULE_PARM_DESC(cpu_selection, "How the CPUs to poll instead should be selected. Supported are 'core' and 'cpu_nr'.");
+MODULE_PARM_DESC(cpu_selection, "In which order the CPUs are selected to sleep, the others poll instead, according to the topology of the kernel.\n"
+				"'core' puts one hardware thread of every core to sleep first, then their siblings, "
+				"'smt' all hardware threads of one core before the next core, "
+				"'llc' and 'die' all CPUs sharing a last level cache or a die before the next one, "
+				"'big' and 'little' the performance or efficiency cores first (P-cores or E-cores), then by their capacity, "
+				"'cpu_nr' the CPUs in the order of their numbers. Default is 'smt', the order of earlier versions on the usual enumeration of siblings.");
+static char *cpu_list = NULL;
+module_param(cpu_list, charp, 0);
+MODULE_PARM_DESC(cpu_list, "The CPUs to measure, e.g. '0-7,16-23'. All other CPUs keep running normally as housekeeping CPUs.\n"
+			   "Package level counters shared with housekeeping CPUs are reported in 'contaminated_counters'.\n"
+			   "By default, all online CPUs are measured.");
+static int interrupt_threshold = 1;
+module_param(interrupt_threshold, int, 0);
+MODULE_PARM_DESC(interrupt_threshold, "A measurement is redone if a CPU received more interrupts than this during it. "
+				      "The interrupts the module causes itself, e.g. to wake up the CPUs and restart the timer of the kernel, are not counted on x86. Default is 1.");
+static int nmi_threshold = 1;
+module_param(nmi_threshold, int, 0);
+MODULE_PARM_DESC(nmi_threshold, "A measurement is redone if a CPU received more NMIs than this during it. "
+				"The NMIs of the HPET ending a measurement, two on some models, are not counted on x86. Default is 1.");
 
 DEFINE_PER_CPU(s64, wakeup_time);
 DEFINE_PER_CPU(u64, wakeups);
+DEFINE_PER_CPU(u64, interrupts);
+DEFINE_PER_CPU(u64, nmis);
 u64 start_time;
 u64 end_time;
 static unsigned repetition;
 
 unsigned cpus_present;
+struct cpumask measured_cpus;
+struct cpumask sleeping_cpus;
+struct cpumask contaminating_cpus;
+static int leader_cpu;
 bool redo_measurement;
 enum mode operation_mode;
 enum entry_mechanism requested_entry_mechanism;
@@ -46,39 +95,84 @@ DEFINE_PER_CPU(enum entry_mechanism, cpu_entry_mechanism);
 
 static atomic_t sync_var;
 
+static DEFINE_PER_CPU(u64, benchmark_arrival);
+static DEFINE_PER_CPU(u64, benchmark_release);
+static DEFINE_PER_CPU(u64, benchmark_snapshot);
+
+// benchmark mode does everything measure mode does, it just times it
+static inline bool takes_measurements(void)
+{
+	return operation_mode == MODE_MEASURE || operation_mode == MODE_BENCHMARK || operation_mode == MODE_REPLAY ||
+	       operation_mode == MODE_PERIODIC;
+}
+
 inline bool is_leader(int cpu)
 {
-	return !cpu;
+	return cpu == leader_cpu;
+}
+
+int get_leader_cpu(void)
+{
+	return leader_cpu;
+}
+
+// whether the measured CPUs have core types, the results are broken down by them
+bool is_hybrid(void)
+{
+	unsigned cpu;
+
+	for_each_cpu(cpu, &measured_cpus)
+	{
+		if (get_core_type(cpu) != CORE_TYPE_UNKNOWN)
+			return true;
+	}
+	return false;
 }
 
 void leader_callback(void)
 {
+	u64 stamp;
+
 	wakeup_other_cpus();
 
-	if (operation_mode == MODE_MEASURE)
-	{
-		end_time = local_clock();
+	end_time = local_clock();
+	if (takes_measurements())
 		set_global_final_values();
+	if (operation_mode == MODE_BENCHMARK)
+	{
+		stamp = local_clock();
+		record_benchmark_sample(BENCHMARK_GLOBAL_SNAPSHOT, stamp - end_time);
 	}
 }
 
 void all_cpus_callback(int this_cpu)
 {
-	if (operation_mode == MODE_MEASURE)
+	u64 stamp = local_clock();
+
+	if (takes_measurements())
 		set_cpu_final_values(this_cpu);
+
+	if (operation_mode == MODE_BENCHMARK)
+		per_cpu(benchmark_snapshot, this_cpu) = local_clock() - stamp;
 }
 
 static inline void sync(int this_cpu)
 {
+	if (operation_mode == MODE_BENCHMARK)
+		per_cpu(benchmark_arrival, this_cpu) = local_clock();
+
 	atomic_inc(&sync_var);
 
 	while (atomic_read(&sync_var) < cpus_present)
 	{
 	}
 
+	if (operation_mode == MODE_BENCHMARK)
+		per_cpu(benchmark_release, this_cpu) = local_clock();
+
 	if (is_leader(this_cpu))
 	{
-		if (operation_mode == MODE_MEASURE)
+		if (takes_measurements())
 		{
 			set_global_start_values();
 
@@ -93,7 +187,7 @@ static inline void sync(int this_cpu)
 	}
 	else
 	{
-		if (operation_mode == MODE_MEASURE)
+		if (takes_measurements())
 		{
 			while (atomic_read(&sync_var) < cpus_present + 1)
 			{
@@ -126,22 +220,59 @@ static void per_cpu_measure(void *info)
 {
 	int this_cpu = seize_core();
 
+	per_cpu(interrupts, this_cpu) = get_interrupt_count(this_cpu);
+	per_cpu(nmis, this_cpu) = get_nmi_count(this_cpu);
+
+	if (is_refilling())
+		warm_working_set(this_cpu);
+
 	sync(this_cpu);
-	do_system_specific_sleep(this_cpu);
+	if (operation_mode == MODE_REPLAY && is_replaying(this_cpu))
+		replay_trace(this_cpu);
+	else if (operation_mode == MODE_PERIODIC && is_replaying(this_cpu))
+		wake_periodically(this_cpu);
+	else
+		do_system_specific_sleep(this_cpu);
+
+	// after the window, so that neither its energy nor the wakeup time of other CPUs include it
+	if (is_refilling())
+		refill_working_set(this_cpu);
 
 	release_core(this_cpu);
 }
 
+// interrupts arriving during a measurement stay pending until the CPU returns from per_cpu_measure(),
+// so they are only counted in a second call
+static void per_cpu_count_interference(void *info)
+{
+	int this_cpu = smp_processor_id();
+
+	per_cpu(interrupts, this_cpu) = get_interrupt_count(this_cpu) - per_cpu(interrupts, this_cpu);
+	per_cpu(nmis, this_cpu) = get_nmi_count(this_cpu) - per_cpu(nmis, this_cpu);
+
+	// the function call IPI delivering this call is not interference
+	if (in_hardirq())
+		per_cpu(interrupts, this_cpu) -= 1;
+}
+
 static void commit_results(unsigned number)
 {
+	unsigned i;
+
 	pkg_stats.start_time[number] = start_time;
 	pkg_stats.end_time[number] = end_time;
 	pkg_stats.repetitions[number] = repetition;
+	// the last repetition still met a criterion for a redo
+	pkg_stats.interfered[number] = redo_measurement;
 
-	for (unsigned i = 0; i < cpus_present; ++i)
+	for_each_cpu(i, &measured_cpus)
 	{
 		cpu_stats[i].wakeup_time[number] = per_cpu(wakeup_time, i);
 		cpu_stats[i].wakeups[number] = per_cpu(wakeups, i);
+		cpu_stats[i].interrupts[number] = per_cpu(interrupts, i);
+		cpu_stats[i].nmis[number] = per_cpu(nmis, i);
+		cpu_stats[i].warm_time[number] = per_cpu(warm_time, i);
+		cpu_stats[i].refill_time[number] = per_cpu(refill_time, i);
 	}
 
 	commit_system_specific_results(number);
@@ -152,6 +283,7 @@ static void commit_results(unsigned number)
 static void evaluate(void)
 {
 	u64 actual_duration;
+	unsigned i;
 
 	evaluate_global();
 
@@ -162,11 +294,19 @@ static void evaluate(void)
 		redo_measurement = true;
 	}
 
-	for (unsigned i = 0; i < cpus_present; ++i)
+	for_each_cpu(i, &measured_cpus)
 	{
 		evaluate_cpu(i);
-		if (per_cpu(cpu_entry_mechanism, i) != ENTRY_MECHANISM_POLL && per_cpu(wakeups, i) >= WAKEUP_THRESHOLD)
+		// replaying and periodically woken CPUs count their idle periods as wakeups
+		if (per_cpu(cpu_entry_mechanism, i) != ENTRY_MECHANISM_POLL && per_cpu(wakeups, i) >= WAKEUP_THRESHOLD && !is_replaying(i))
+			redo_measurement = true;
+		if (per_cpu(interrupts, i) > interrupt_threshold || per_cpu(nmis, i) > nmi_threshold)
 			redo_measurement = true;
+		if (operation_mode == MODE_PERIODIC && is_replaying(i) && missed_periodic_wakeups(i, actual_duration))
+		{
+			printk(KERN_WARNING "CPU %u was not woken up at the requested rate, %llu wakeups in %llu ns.\n", i, per_cpu(wakeups, i), actual_duration);
+			redo_measurement = true;
+		}
 	}
 }
 
@@ -174,6 +314,8 @@ static void evaluate(void)
 
 static void measure(unsigned number)
 {
+	unsigned i;
+
 	repetition = 0;
 	redo_measurement = false;
 
@@ -194,12 +336,13 @@ static void measure(unsigned number)
 		}
 		redo_measurement = false;
 
-		for (unsigned i = 0; i < cpus_present; ++i)
+		for_each_cpu(i, &measured_cpus)
 			per_cpu(wakeups, i) = 0;
 		atomic_set(&sync_var, 0);
 		prepare_before_each_measurement();
 
-		on_each_cpu(per_cpu_measure, NULL, 1);
+		on_each_cpu_mask(&measured_cpus, per_cpu_measure, NULL, 1);
+		on_each_cpu_mask(&measured_cpus, per_cpu_count_interference, NULL, 1);
 
 		evaluate();
 
@@ -209,39 +352,172 @@ static void measure(unsigned number)
 	commit_results(number);
 }
 
-static bool should_sleep(int cpu)
+#define SELECTION_KEYS (4)
+
+// the CPUs are put to sleep in the order of these keys, compared one after the other
+static u64 selection_keys[MAX_CPUS][SELECTION_KEYS];
+
+// position of the CPU among the measured hardware threads of its core
+static u64 get_thread_rank(int cpu)
+{
+	u64 rank = 0;
+	unsigned sibling;
+
+	for_each_cpu(sibling, topology_sibling_cpumask(cpu))
+	{
+		if (sibling < cpu && cpumask_test_cpu(sibling, &measured_cpus))
+			++rank;
+	}
+	return rank;
+}
+
+// the core type reported by the hardware comes first, the scheduler does not tell them apart on every kernel
+static u64 get_core_type_rank(int cpu, enum core_type first)
+{
+	enum core_type type = get_core_type(cpu);
+
+	if (type == first)
+		return 0;
+	return type == CORE_TYPE_UNKNOWN ? 1 : 2;
+}
+
+static int set_selection_keys(int cpu, u64 *keys)
+{
+	u64 thread_rank = get_thread_rank(cpu);
+
+	memset(keys, 0, SELECTION_KEYS * sizeof(*keys));
+	if (strcmp(cpu_selection, "core") == 0)
+	{
+		keys[0] = thread_rank;
+		keys[1] = cpu;
+	}
+	else if (strcmp(cpu_selection, "smt") == 0)
+	{
+		keys[0] = cpumask_first(topology_sibling_cpumask(cpu));
+		keys[1] = cpu;
+	}
+	else if (strcmp(cpu_selection, "llc") == 0)
+	{
+		keys[0] = cpumask_first(get_llc_cpumask(cpu));
+		keys[1] = thread_rank;
+		keys[2] = cpu;
+	}
+	else if (strcmp(cpu_selection, "die") == 0)
+	{
+		keys[0] = cpumask_first(topology_die_cpumask(cpu));
+		keys[1] = cpumask_first(get_llc_cpumask(cpu));
+		keys[2] = thread_rank;
+		keys[3] = cpu;
+	}
+	else if (strcmp(cpu_selection, "big") == 0)
+	{
+		keys[0] = get_core_type_rank(cpu, CORE_TYPE_PERFORMANCE);
+		keys[1] = SCHED_CAPACITY_SCALE - min(arch_scale_cpu_capacity(cpu), SCHED_CAPACITY_SCALE);
+		keys[2] = thread_rank;
+		keys[3] = cpu;
+	}
+	else if (strcmp(cpu_selection, "little") == 0)
+	{
+		keys[0] = get_core_type_rank(cpu, CORE_TYPE_EFFICIENCY);
+		keys[1] = arch_scale_cpu_capacity(cpu);
+		keys[2] = thread_rank;
+		keys[3] = cpu;
+	}
+	else if (strcmp(cpu_selection, "cpu_nr") == 0)
+	{
+		keys[0] = cpu;
+	}
+	else
+	{
+		printk(KERN_ERR "CPU selection '%s' unknown, aborting!\n", cpu_selection);
+		return 1;
+	}
+	return 0;
+}
+
+static int compare_selection_keys(const void *a, const void *b)
 {
-	if (strcmp(cpu_selection, "cpu_nr") == 0)
+	const u64 *keys_a = selection_keys[*(const int *)a];
+	const u64 *keys_b = selection_keys[*(const int *)b];
+	unsigned i;
+
+	for (i = 0; i < SELECTION_KEYS; ++i)
 	{
-		return cpu < cpus_sleep;
+		if (keys_a[i] != keys_b[i])
+			return keys_a[i] < keys_b[i] ? -1 : 1;
 	}
+	return 0;
+}
+
+// the first cpus_sleep CPUs in the order of cpu_selection sleep, the others poll
+static int select_sleeping_cpus(void)
+{
+	static int order[MAX_CPUS];
+	unsigned count = 0;
+	unsigned i;
 
-	return (cpu < cpus_present / 2
-		    ? 2 * cpu
-		    : (cpu - (cpus_present / 2)) * 2 + 1) < cpus_sleep;
+	if (cpus_sleep == -1)
+		cpus_sleep = cpus_present;
+
+	for_each_cpu(i, &measured_cpus)
+	{
+		if (set_selection_keys(i, selection_keys[i]))
+			return 1;
+		order[count++] = i;
+	}
+	sort(order, count, sizeof(order[0]), compare_selection_keys, NULL);
+
+	cpumask_clear(&sleeping_cpus);
+	for (i = 0; i < count && i < cpus_sleep; ++i)
+		cpumask_set_cpu(order[i], &sleeping_cpus);
+
+	printk(KERN_INFO "CPUs %*pbl sleep, selected by '%s'.\n", cpumask_pr_args(&sleeping_cpus), cpu_selection);
+	return 0;
 }
 
 static int measurement_init(void)
 {
+	unsigned i;
+
+	if (select_sleeping_cpus())
+		return 1;
 	if (prepare_measurements())
 		return 1;
 
+	if (operation_mode == MODE_REPLAY && (prepare_replay() || load_replay_trace()))
+	{
+		cleanup_measurements();
+		return 1;
+	}
+	if (operation_mode == MODE_PERIODIC && (prepare_replay() || prepare_periodic_wakeups()))
+	{
+		cleanup_measurements();
+		return 1;
+	}
+	if (prepare_working_sets())
+	{
+		cleanup_measurements();
+		if (operation_mode == MODE_REPLAY)
+			free_replay_trace();
+		return 1;
+	}
+
 	measurement_count = measurement_count < MAX_NUMBER_OF_MEASUREMENTS
 				? measurement_count
 				: MAX_NUMBER_OF_MEASUREMENTS;
 
-	if (cpus_sleep == -1)
-		cpus_sleep = cpus_present;
-
-	for (unsigned i = 0; i < cpus_present; ++i)
-		per_cpu(cpu_entry_mechanism, i) = should_sleep(i) ? requested_entry_mechanism : ENTRY_MECHANISM_POLL;
+	for_each_cpu(i, &measured_cpus)
+		per_cpu(cpu_entry_mechanism, i) = cpumask_test_cpu(i, &sleeping_cpus) ? get_requested_entry_mechanism(i) : ENTRY_MECHANISM_POLL;
 
-	for (unsigned i = 0; i < measurement_count; ++i)
+	for (i = 0; i < measurement_count; ++i)
 	{
 		measure(i);
 	}
 
 	cleanup_measurements();
+	if (operation_mode == MODE_REPLAY)
+		free_replay_trace();
+	free_working_sets();
 	publish_measurement_results();
 
 	printk(KERN_INFO "MWAIT: Measurements done.\n");
@@ -249,66 +525,252 @@ static int measurement_init(void)
 	return 0;
 }
 
-static enum entry_mechanism signal_mechanisms[] = {ENTRY_MECHANISM_POLL, ENTRY_MECHANISM_UNKNOWN};
+static const u8 barker_code[] = {1, 1, 1, 1, 1, 0, 0, 1, 1, 0, 1, 0, 1};
+static const u8 square_code[] = {1, 0, 1, 0};
+// second tap of the maximum length LFSR x^n + x^m + 1, indexed by the order n
+static const u8 prbs_taps[MAX_SIGNAL_ORDER + 1] = {0, 0, 1, 2, 3, 3, 5, 6};
+
+static int generate_signal_code(void)
+{
+	unsigned state, feedback;
+	unsigned i;
+
+	if (strcmp(signal_code, "barker") == 0)
+	{
+		signal_stat.level_count = ARRAY_SIZE(barker_code);
+		for (i = 0; i < signal_stat.level_count; ++i)
+			signal_stat.signal_code[i] = barker_code[i];
+	}
+	else if (strcmp(signal_code, "square") == 0)
+	{
+		signal_stat.level_count = ARRAY_SIZE(square_code);
+		for (i = 0; i < signal_stat.level_count; ++i)
+			signal_stat.signal_code[i] = square_code[i];
+	}
+	else if (strcmp(signal_code, "prbs") == 0)
+	{
+		if (signal_order < 2 || signal_order > MAX_SIGNAL_ORDER)
+		{
+			printk(KERN_ERR "Order %i of the signal not supported, aborting!\n", signal_order);
+			return 1;
+		}
+		signal_stat.level_count = (1 << signal_order) - 1;
+		state = signal_stat.level_count;
+		for (i = 0; i < signal_stat.level_count; ++i)
+		{
+			signal_stat.signal_code[i] = state & 1;
+			feedback = (state ^ (state >> (signal_order - prbs_taps[signal_order]))) & 1;
+			state = (state >> 1) | (feedback << (signal_order - 1));
+		}
+	}
+	else
+	{
+		printk(KERN_ERR "Signal code '%s' unknown, aborting!\n", signal_code);
+		return 1;
+	}
+	return 0;
+}
 
 static void per_cpu_signal(void *info)
 {
+	unsigned level = *(unsigned *)info;
 	int this_cpu = seize_core();
 
-	int i = 0;
-	for (; i < SIGNAL_EDGE_COUNT + 1; ++i)
+	sync(this_cpu);
+	if (is_leader(this_cpu))
+		signal_stat.signal_times[level] = local_clock();
+
+	do_system_specific_sleep(this_cpu);
+
+	release_core(this_cpu);
+}
+
+// every level is a window of its own, so the CPUs synchronize and the timer is armed again for each edge
+static int signal_init(void)
+{
+	enum entry_mechanism low_mechanism = get_signal_low_mechanism();
+	unsigned level, i;
+
+	if (generate_signal_code())
+		return 1;
+
+	for (level = 0; level < signal_stat.level_count; ++level)
 	{
-		per_cpu(cpu_entry_mechanism, this_cpu) = signal_mechanisms[i & 1];
+		for_each_cpu(i, &measured_cpus)
+			per_cpu(cpu_entry_mechanism, i) = signal_stat.signal_code[level] ? ENTRY_MECHANISM_POLL : low_mechanism;
+		atomic_set(&sync_var, 0);
+		prepare_before_each_measurement();
 
-		sync(this_cpu);
-		if (is_leader(this_cpu))
-			signal_stat.signal_times[i] = local_clock();
+		on_each_cpu_mask(&measured_cpus, per_cpu_signal, &level, 1);
 
-		do_system_specific_sleep(this_cpu);
+		cleanup_after_each_measurement();
 	}
-	signal_stat.signal_times[i] = local_clock();
+	signal_stat.signal_times[level] = end_time;
 
-	release_core(this_cpu);
+	publish_signal_times();
+
+	return 0;
 }
 
-static void signal_init(void)
+static void evaluate_benchmark_iteration(void)
 {
-	signal_mechanisms[1] = get_signal_low_mechanism();
+	u64 last_arrival = 0, last_release = 0, slowest_snapshot = 0;
+	s64 slowest_wakeup = 0;
+	unsigned i;
 
-	on_each_cpu(per_cpu_signal, NULL, 1);
+	evaluate_global();
 
-	publish_signal_times();
+	for_each_cpu(i, &measured_cpus)
+	{
+		evaluate_cpu(i);
+
+		last_arrival = max(last_arrival, per_cpu(benchmark_arrival, i));
+		last_release = max(last_release, per_cpu(benchmark_release, i));
+		slowest_snapshot = max(slowest_snapshot, per_cpu(benchmark_snapshot, i));
+		if (!is_leader(i))
+			slowest_wakeup = max(slowest_wakeup, per_cpu(wakeup_time, i));
+	}
+
+	record_benchmark_sample(BENCHMARK_SYNC, last_release - last_arrival);
+	record_benchmark_sample(BENCHMARK_WINDOW_END, max(per_cpu(wakeup_time, leader_cpu), 0LL));
+	record_benchmark_sample(BENCHMARK_CPU_SNAPSHOT, slowest_snapshot);
+	if (cpus_present > 1)
+		record_benchmark_sample(BENCHMARK_WAKEUP, slowest_wakeup);
+}
+
+static int benchmark_init(void)
+{
+	unsigned i;
+
+	if (prepare_measurements())
+		return 1;
+
+	benchmark_iterations = benchmark_iterations < MAX_BENCHMARK_ITERATIONS
+				   ? benchmark_iterations
+				   : MAX_BENCHMARK_ITERATIONS;
+
+	for_each_cpu(i, &measured_cpus)
+		per_cpu(cpu_entry_mechanism, i) = get_requested_entry_mechanism(i);
+
+	for (i = 0; i < benchmark_iterations; ++i)
+	{
+		atomic_set(&sync_var, 0);
+		prepare_before_each_measurement();
+
+		on_each_cpu_mask(&measured_cpus, per_cpu_measure, NULL, 1);
+
+		evaluate_benchmark_iteration();
+
+		cleanup_after_each_measurement();
+	}
+
+	cleanup_measurements();
+
+	benchmark_format();
+	evaluate_benchmark();
+	publish_benchmark_results();
+
+	printk(KERN_INFO "MWAIT: Benchmark done.\n");
+
+	return 0;
+}
+
+static int select_measured_cpus(void)
+{
+	if (cpu_list == NULL)
+	{
+		cpumask_copy(&measured_cpus, cpu_online_mask);
+	}
+	else if (cpulist_parse(cpu_list, &measured_cpus))
+	{
+		printk(KERN_ERR "Interpreting cpu_list failed, aborting!\n");
+		return 1;
+	}
+	cpumask_and(&measured_cpus, &measured_cpus, cpu_online_mask);
+
+	if (cpumask_empty(&measured_cpus))
+	{
+		printk(KERN_ERR "No online CPU selected for measuring, aborting!\n");
+		return 1;
+	}
+	if (cpumask_last(&measured_cpus) >= MAX_CPUS)
+	{
+		printk(KERN_ERR "Only CPUs below %i can be measured, aborting!\n", MAX_CPUS);
+		return 1;
+	}
+
+	cpus_present = cpumask_weight(&measured_cpus);
+	leader_cpu = cpumask_first(&measured_cpus);
+
+	// package level counters also count everything the housekeeping CPUs sharing them do
+	cpumask_andnot(&contaminating_cpus, get_package_counter_scope(leader_cpu), &measured_cpus);
+	cpumask_and(&contaminating_cpus, &contaminating_cpus, cpu_online_mask);
+
+	printk(KERN_INFO "Measuring CPUs %*pbl, leader is CPU %i.\n", cpumask_pr_args(&measured_cpus), leader_cpu);
+	if (!cpumask_empty(&contaminating_cpus))
+		printk(KERN_WARNING "WARNING: Package level counters are shared with housekeeping CPUs %*pbl.\n", cpumask_pr_args(&contaminating_cpus));
+
+	return 0;
 }
 
 static int mwait_init(void)
 {
+	int err = 0;
+
+	if (select_measured_cpus())
+		return 1;
+
 	preliminary_checks();
+
+	// discovering only reads CPUID and the topology, the timer and the rest of prepare() would be set up for nothing
+	if (strcmp(mode, "discover") == 0)
+	{
+		operation_mode = MODE_DISCOVER;
+		discovery_stat.hint_count = get_entry_hints(discovery_stat.hints, MAX_ENTRY_HINTS);
+		printk(KERN_INFO "MWAIT: Discovered %llu entry hints.\n", discovery_stat.hint_count);
+		publish_discovered_hints();
+		return 0;
+	}
+
 	if (prepare())
 		return 1;
 
-	cpus_present = num_present_cpus();
-
 	if (strcmp(mode, "measure") == 0)
 	{
 		operation_mode = MODE_MEASURE;
-		if (measurement_init())
-			return 1;
+		err = measurement_init();
 	}
 	else if (strcmp(mode, "signal") == 0)
 	{
 		operation_mode = MODE_SIGNAL;
-		signal_init();
+		err = signal_init();
+	}
+	else if (strcmp(mode, "benchmark") == 0)
+	{
+		operation_mode = MODE_BENCHMARK;
+		err = benchmark_init();
+	}
+	else if (strcmp(mode, "replay") == 0)
+	{
+		operation_mode = MODE_REPLAY;
+		err = measurement_init();
+	}
+	else if (strcmp(mode, "periodic") == 0)
+	{
+		operation_mode = MODE_PERIODIC;
+		err = measurement_init();
 	}
 	else
 	{
 		operation_mode = MODE_UNKNOWN;
 		printk(KERN_ERR "Mode '%s' unknown, aborting!\n", mode);
-		return 1;
+		err = 1;
 	}
 
+	// also if the mode failed, as prepare() registered the NMI handler and set up the timer
 	cleanup();
 
-	return 0;
+	return err;
 }
 
 static void mwait_exit(void)
@@ -316,11 +778,19 @@ static void mwait_exit(void)
 	switch (operation_mode)
 	{
 	case MODE_MEASURE:
+	case MODE_REPLAY:
+	case MODE_PERIODIC:
 		cleanup_measurement_results();
 		break;
 	case MODE_SIGNAL:
 		cleanup_signal_times();
 		break;
+	case MODE_BENCHMARK:
+		cleanup_benchmark_results();
+		break;
+	case MODE_DISCOVER:
+		cleanup_discovered_hints();
+		break;
 	case MODE_UNKNOWN:
 		break;
 	}
@@ -5,27 +5,71 @@ help() {
     echo "### Measure script ###"
     echo "######################"
     echo
-    echo "Syntax: measure.sh [-s|p|h] <duration>"
+    echo "Syntax: measure.sh [-s|g <code>|I <seconds>|b|H|L|R <trace>|W <sizes>|F <rates>|C <limits>|D <settings>|P <policies>|p|n <count>|r <rounds>|S <seed>|c <cpus>|t <timer>|T <temperature>|E <path>|h] <duration>"
     echo "Description:"
     echo "    <duration>: Duration of a single measurement in milliseconds."
     echo "                Should depend mainly on temporal resolution of power measurement method."
     echo
-    echo "    -s: Generate power pattern and timestamps for synchronization with external power logging"
+    echo "    -s: Generate power pattern and timestamps for synchronization with external power logging, at the start and the end"
+    echo "    -I: Repeat the synchronization pattern in between the measurements after this many seconds (default 300)"
+    echo "    -g: Code of the synchronization pattern, 'barker' (default), 'prbs<order>' (e.g. prbs6) or 'square'"
+    echo "    -b: Benchmark the overhead of the measurement harness itself before measuring"
+    echo "    -H: Also measure all MWAIT hints the CPU enumerates, including the ones the idle driver does not use (x86)"
+    echo "    -L: Also measure every idle state with half the window length, to separate its entry and exit energy (scripts/recommendCpuidle.py)"
+    echo "    -R: Also measure while replaying this idle trace (scripts/convertIdleTrace.py) on all measured CPUs but the first (x86)"
+    echo "    -W: Also measure every idle state with each CPU touching a working set of these sizes in KiB (e.g. 32,1024,32768) before sleeping and after waking up"
+    echo "    -F: Also measure every MWAIT state while waking up all CPUs but the first periodically at these rates per second (e.g. 100,1000,10000),"
+    echo "        both at the same time and staggered (x86)"
+    echo "    -C: Also measure every idle state with each of these Package C-state limits (e.g. 0,1,2,3,7), see pkg_cstate_limit of the module (Intel)"
+    echo "    -D: Also measure every idle state with each of these C-state auto-demotion settings (e.g. 0,3,15), see auto_demotion of the module (Intel)"
+    echo "    -P: Also measure the number of sleeping CPUs with each of these selection policies (e.g. smt,llc,little), see cpu_selection of the module"
     echo "    -p: Deactivate Package C-states for measurement duration (Intel)"
+    echo "    -n: Number of measurements of each configuration (default 10, at most 100), the total is kept when they are split into rounds"
+    echo "    -r: Split the measurements of each configuration into this many rounds, interleaving all configurations in shuffled order"
+    echo "    -S: Seed for shuffling the configurations, by default a random one is used (recorded in the results either way)"
+    echo "    -c: Only measure the given CPUs (e.g. 0-7), the others keep running normally as housekeeping CPUs"
+    echo "    -t: Timer ending the measurements, 'HPET' (default) or 'TSC_DEADLINE' (x86)"
+    echo "    -T: Before each measurement, wait for the package to cool down to this temperature in degrees Celsius (Intel)"
+    echo "    -E: Path of the energy source to use (ARM), by default the first hwmon energy sensor is used if one exists"
     echo "    -h: Print help, then quit"
 }
 
 DEACTIVATE_PCSTATES=0
 
-while getopts "sph" option; do
+while getopts "sg:I:bHLR:W:F:C:D:P:pn:r:S:c:t:T:E:h" option; do
     case $option in
     (s) SIGNAL_REQUESTED=true;;
+    (g) SIGNAL_CODE=$OPTARG;;
+    (I) SIGNAL_INTERVAL=$OPTARG;;
+    (b) BENCHMARK_REQUESTED=true;;
+    (H) HINTS_REQUESTED=true;;
+    (L) TRANSITIONS_REQUESTED=true;;
+    (R) REPLAY_TRACE=$(realpath "$OPTARG");;
+    (W) WORKING_SETS=$OPTARG;;
+    (F) WAKEUP_RATES=$OPTARG;;
+    (C) PKG_CSTATE_LIMITS=$OPTARG;;
+    (D) AUTO_DEMOTIONS=$OPTARG;;
+    (P) CPU_SELECTIONS=$OPTARG;;
     (p) DEACTIVATE_PCSTATES=1;;
+    (n) MEASUREMENT_COUNT=$OPTARG;;
+    (r) ROUNDS=$OPTARG;;
+    (S) SEED=$OPTARG;;
+    (c) CPU_LIST=$OPTARG;;
+    (t) TIMER=$OPTARG;;
+    (T) COOLDOWN_TEMPERATURE=$OPTARG;;
+    (E) ENERGY_SOURCE=$OPTARG;;
     (h) help; exit;;
     esac
 done
 shift $((OPTIND - 1))
 
+MEASUREMENT_COUNT=${MEASUREMENT_COUNT:-10}
+ROUNDS=${ROUNDS:-1}
+if [[ $ROUNDS -gt $MEASUREMENT_COUNT ]]; then
+    echo "Cannot split $MEASUREMENT_COUNT measurements into $ROUNDS rounds, aborting!"
+    exit 1
+fi
+
 # preparation
 pushd "$(dirname "$0")"
 
@@ -46,28 +90,142 @@ fi
 MEASURE_DURATION=$1
 echo "$MEASURE_DURATION" > $RESULTS_DIR/duration
 
+# count_cpus <cpu list>: the number of CPUs in a list like 0-7,16-23
+function count_cpus {
+    local COUNT=0
+    local RANGE
+    for RANGE in ${1//,/ };
+    do
+        COUNT=$((COUNT + ${RANGE#*-} - ${RANGE%-*} + 1))
+    done
+    echo $COUNT
+}
+
+MODULE_OPTIONS="duration=$MEASURE_DURATION"
+MEASURED_CPU_COUNT=$(getconf _NPROCESSORS_ONLN)
+if [[ -n "$CPU_LIST" ]]; then
+    MODULE_OPTIONS="$MODULE_OPTIONS cpu_list=$CPU_LIST"
+    MEASURED_CPU_COUNT=$(count_cpus $CPU_LIST)
+fi
+if [[ "$(uname -m)" == 'aarch64' ]]; then
+    if [[ -z "$ENERGY_SOURCE" ]]; then
+        ENERGY_SOURCE=$(ls /sys/class/hwmon/hwmon*/energy*_input 2> /dev/null | head -n 1)
+    fi
+    if [[ -n "$ENERGY_SOURCE" ]]; then
+        MODULE_OPTIONS="$MODULE_OPTIONS energy_source=$ENERGY_SOURCE"
+    fi
+else
+    MODULE_OPTIONS="$MODULE_OPTIONS deactivate_pcstates=$DEACTIVATE_PCSTATES"
+    if [[ -n "$TIMER" ]]; then
+        MODULE_OPTIONS="$MODULE_OPTIONS timer=$TIMER"
+    fi
+    if [[ -n "$COOLDOWN_TEMPERATURE" ]]; then
+        MODULE_OPTIONS="$MODULE_OPTIONS cooldown_temperature=$COOLDOWN_TEMPERATURE"
+    fi
+fi
+
+# measure <name> <module options> <measurement type> <number of polling CPUs> [<results folder>]
 function measure {
-    insmod mwait.ko $2 duration=$MEASURE_DURATION deactivate_pcstates=$DEACTIVATE_PCSTATES
-    cp -r /sys/mwait_measurements $RESULTS_DIR/$3/$1
+    local DIR=${5:-$RESULTS_DIR/$3/$1}
+    mkdir -p "$(dirname "$DIR")"
+    insmod mwait.ko $MODULE_OPTIONS $2
+    cp -r /sys/mwait_measurements $DIR
+    echo "$4" > $DIR/polling_cpus
+    # parameters the evaluation needs, e.g. the window length of measurements differing from the global one
+    local PARAM
+    for PARAM in duration working_set wakeup_rate wakeup_alignment pkg_cstate_limit auto_demotion;
+    do
+        if [[ "$2" =~ (^| )$PARAM=([^ ]+) ]]; then
+            echo "${BASH_REMATCH[2]}" > $DIR/$PARAM
+        fi
+    done
     rmmod mwait
 }
 
-# synchronization signal
+# the configurations are only collected first, so that they can be measured in interleaved rounds
+SCHEDULED_NAMES=()
+SCHEDULED_OPTIONS=()
+SCHEDULED_TYPES=()
+SCHEDULED_POLLING=()
+function schedule {
+    SCHEDULED_NAMES+=("$1")
+    SCHEDULED_OPTIONS+=("$2")
+    SCHEDULED_TYPES+=("$3")
+    SCHEDULED_POLLING+=("$4")
+}
+
+# every file with one value per measurement is concatenated, the others are the same in every round
+function merge_rounds {
+    local DIR=$1
+    local FILE
+    for FILE in $(cd $DIR/round1 && find . -type f);
+    do
+        mkdir -p "$(dirname "$DIR/$FILE")"
+        case $(basename "$FILE") in
+        (measured_cpus|contaminating_cpus|contaminated_counters|polling_cpus|sleeping_cpus|performance_cpus|efficiency_cpus|core_type|duration|working_set|wakeup_rate|wakeup_alignment|pkg_cstate_limit|auto_demotion)
+            cp $DIR/round1/$FILE $DIR/$FILE;;
+        (*)
+            for ((ROUND=1; ROUND<=ROUNDS; ROUND++));
+            do
+                cat $DIR/round$ROUND/$FILE
+            done > $DIR/$FILE;;
+        esac
+    done
+    for ((ROUND=1; ROUND<=ROUNDS; ROUND++));
+    do
+        rm -r $DIR/round$ROUND
+    done
+}
+
+# synchronization signal, repeated periodically so that the clock of the power logger can be followed over long runs
+if [[ "$SIGNAL_CODE" =~ ^prbs([0-9]+)$ ]]; then
+    SIGNAL_OPTIONS="signal_code=prbs signal_order=${BASH_REMATCH[1]}"
+elif [[ -n "$SIGNAL_CODE" ]]; then
+    SIGNAL_OPTIONS="signal_code=$SIGNAL_CODE"
+fi
+SIGNAL_INTERVAL=${SIGNAL_INTERVAL:-300}
+SIGNAL_COUNT=0
+
+# signal <file for the timestamps>
+function signal {
+    insmod mwait.ko mode=signal $MODULE_OPTIONS $SIGNAL_OPTIONS
+    cp /sys/mwait_measurements/signal_times $RESULTS_DIR/$1
+    cp /sys/mwait_measurements/signal_code $RESULTS_DIR/
+    rmmod mwait
+    LAST_SIGNAL=$SECONDS
+}
+
 if [ "$SIGNAL_REQUESTED" = true ]; then
-    insmod mwait.ko mode=signal duration=$MEASURE_DURATION
-    cp -r /sys/mwait_measurements/signal_times $RESULTS_DIR/
+    signal signal_times
+fi
+
+# harness overhead, polling so that no idle state exit latency is included
+if [ "$BENCHMARK_REQUESTED" = true ]; then
+    insmod mwait.ko mode=benchmark entry_mechanism=POLL $MODULE_OPTIONS duration=1
+    cp -r /sys/mwait_measurements $RESULTS_DIR/benchmark
     rmmod mwait
 fi
 
-# measurements
+# calibration of the baseline energy included in every measurement
+# the energy per window follows from measuring two window lengths, the power of a polling CPU from all CPUs polling
+MEASUREMENT_NAME=calibration
+schedule sleep "" $MEASUREMENT_NAME 0
+schedule sleep_half "duration=$((MEASURE_DURATION / 2))" $MEASUREMENT_NAME 0
+schedule poll "entry_mechanism=POLL" $MEASUREMENT_NAME $MEASURED_CPU_COUNT
+
+# idle states, their current cpuidle values are kept to compare them with the measurements
 if [[ -e /sys/devices/system/cpu/cpu0/cpuidle ]]; then
     MEASUREMENT_NAME=states
-    mkdir $RESULTS_DIR/$MEASUREMENT_NAME
+    echo "state,name,latency,target_residency" > $RESULTS_DIR/cpuidle_states
     for STATE in /sys/devices/system/cpu/cpu0/cpuidle/state*;
     do
         NAME=$(< "$STATE"/name);
+        INDEX=$(basename "$STATE"); INDEX=${INDEX#state};
+        echo "$(basename "$STATE"),$NAME,$(< "$STATE"/latency),$(< "$STATE"/residency)" >> $RESULTS_DIR/cpuidle_states
         if [[ "$NAME" == 'POLL' ]]; then
-            measure $NAME "entry_mechanism=POLL" $MEASUREMENT_NAME
+            REPLAY_STATES[$INDEX]=POLL
+            # polling is the measured state here, so its power is not subtracted as the one of polling CPUs
+            schedule $NAME "entry_mechanism=POLL" $MEASUREMENT_NAME 0
             continue;
         fi
         DESC=$(< "$STATE"/desc);
@@ -75,28 +233,236 @@ if [[ -e /sys/devices/system/cpu/cpu0/cpuidle ]]; then
             DESC=${DESC#ACPI };
             if [[ "${DESC%% *}" == 'IOPORT' ]]; then
                 IO_PORT=${DESC#IOPORT };
-                measure $NAME "entry_mechanism=IOPORT io_port=$IO_PORT" $MEASUREMENT_NAME
+                schedule $NAME "entry_mechanism=IOPORT io_port=$IO_PORT" $MEASUREMENT_NAME 0
             elif [[ "${DESC%% *}" == 'FFH' ]]; then
                 DESC=${DESC#FFH };
                 if [[ "${DESC%% *}" == 'MWAIT' ]]; then
                     MWAIT_HINT=${DESC#MWAIT };
-                    measure $NAME "entry_mechanism=MWAIT mwait_hint=$MWAIT_HINT" $MEASUREMENT_NAME
+                    DRIVER_HINTS+=($(printf '0x%02x' $MWAIT_HINT))
+                    REPLAY_STATES[$INDEX]=$MWAIT_HINT
+                    schedule $NAME "entry_mechanism=MWAIT mwait_hint=$MWAIT_HINT" $MEASUREMENT_NAME 0
                 fi
+            elif [[ "${DESC%% *}" == 'HLT' ]]; then
+                schedule $NAME "entry_mechanism=HLT" $MEASUREMENT_NAME 0
             fi
         elif [[ "${DESC%% *}" == 'MWAIT' ]]; then   # the Intel cpuidle driver does not prefix the description
             MWAIT_HINT=${DESC#MWAIT };
-            measure $NAME "entry_mechanism=MWAIT mwait_hint=$MWAIT_HINT" $MEASUREMENT_NAME
+            DRIVER_HINTS+=($(printf '0x%02x' $MWAIT_HINT))
+            REPLAY_STATES[$INDEX]=$MWAIT_HINT
+            schedule $NAME "entry_mechanism=MWAIT mwait_hint=$MWAIT_HINT" $MEASUREMENT_NAME 0
+        fi
+    done
+    STATE_COUNT=$INDEX
+fi
+
+# an idle trace captured elsewhere, its idle states are entered like the cpuidle states of the same index here
+if [[ -n "$REPLAY_TRACE" ]]; then
+    if [[ ${#REPLAY_STATES[@]} -ne $((STATE_COUNT + 1)) ]]; then
+        echo "Only idle states entered with MWAIT can be replayed, not replaying $REPLAY_TRACE"
+    else
+        schedule $(basename "$REPLAY_TRACE" .bin) "mode=replay trace_file=$REPLAY_TRACE replay_states=$(IFS=,; echo "${REPLAY_STATES[*]}")" replay 0
+    fi
+fi
+
+# all MWAIT hints enumerated by CPUID, the idle driver may leave out states that are supported by the hardware
+if [[ "$HINTS_REQUESTED" = true && "$(uname -m)" == 'x86_64' ]]; then
+    MEASUREMENT_NAME=hints
+    insmod mwait.ko mode=discover $MODULE_OPTIONS
+    HINTS=$(< /sys/mwait_measurements/hints)
+    rmmod mwait
+    for HINT in $HINTS;
+    do
+        HINT=$(printf '0x%02x' $HINT)
+        schedule $HINT "entry_mechanism=MWAIT mwait_hint=$HINT" $MEASUREMENT_NAME 0
+        if [[ ! " ${DRIVER_HINTS[*]} " =~ " $HINT " ]]; then
+            echo "$HINT" >> $RESULTS_DIR/unused_hints
+        fi
+    done
+fi
+
+# hybrid CPUs: the idle states of each core type with the CPUs of the other type polling, as the states and their cost differ
+# the states are the cpuidle states of the first CPU of the type
+if [[ "$(uname -m)" == 'x86_64' ]] && grep -qw hybrid_cpu /proc/cpuinfo; then
+    insmod mwait.ko mode=discover $MODULE_OPTIONS
+    PERFORMANCE_CPUS=$(< /sys/mwait_measurements/performance_cpus)
+    EFFICIENCY_CPUS=$(< /sys/mwait_measurements/efficiency_cpus)
+    rmmod mwait
+fi
+if [[ -n "$PERFORMANCE_CPUS" && -n "$EFFICIENCY_CPUS" ]]; then
+    for STATE in /sys/devices/system/cpu/cpu${PERFORMANCE_CPUS%%[-,]*}/cpuidle/state*;
+    do
+        DESC=$(< "$STATE"/desc); DESC=${DESC#ACPI }; DESC=${DESC#FFH };
+        if [[ "${DESC%% *}" == 'MWAIT' ]]; then
+            schedule $(< "$STATE"/name) "entry_mechanism=MWAIT mwait_hint=${DESC#MWAIT } efficiency_entry_mechanism=POLL" states_performance $(count_cpus $EFFICIENCY_CPUS)
+        fi
+    done
+    for STATE in /sys/devices/system/cpu/cpu${EFFICIENCY_CPUS%%[-,]*}/cpuidle/state*;
+    do
+        DESC=$(< "$STATE"/desc); DESC=${DESC#ACPI }; DESC=${DESC#FFH };
+        if [[ "${DESC%% *}" == 'MWAIT' ]]; then
+            schedule $(< "$STATE"/name) "entry_mechanism=POLL efficiency_entry_mechanism=MWAIT efficiency_mwait_hint=${DESC#MWAIT }" states_efficiency $(count_cpus $PERFORMANCE_CPUS)
+        fi
+    done
+fi
+
+# entry mechanisms besides the ones of the idle states, as used by spin-wait code
+if [[ "$(uname -m)" == 'x86_64' ]]; then
+    MEASUREMENT_NAME=mechanisms
+    schedule HLT "entry_mechanism=HLT" $MEASUREMENT_NAME 0
+    if grep -qw waitpkg /proc/cpuinfo; then
+        for MECHANISM in UMWAIT TPAUSE;
+        do
+            schedule ${MECHANISM}_C0.1 "entry_mechanism=$MECHANISM wait_state=1" $MEASUREMENT_NAME 0
+            schedule ${MECHANISM}_C0.2 "entry_mechanism=$MECHANISM wait_state=2" $MEASUREMENT_NAME 0
+        done
+    fi
+    if grep -qw mwaitx /proc/cpuinfo; then
+        schedule MWAITX "entry_mechanism=MWAITX" $MEASUREMENT_NAME 0
+    fi
+fi
+
+# PSCI idle states are not described in cpuidle, but in the device tree
+if [[ -e /proc/device-tree/cpus/idle-states ]]; then
+    MEASUREMENT_NAME=states
+    schedule WFI "entry_mechanism=WFI" $MEASUREMENT_NAME 0
+    for STATE in /proc/device-tree/cpus/idle-states/*/;
+    do
+        if [[ ! -e "$STATE"/arm,psci-suspend-param ]]; then
+            continue;
+        fi
+        NAME=$(basename "$STATE");
+        PSCI_STATE=0x$(od -An -tx1 "$STATE"/arm,psci-suspend-param | tr -d ' \n');
+        schedule $NAME "entry_mechanism=PSCI psci_state=$PSCI_STATE" $MEASUREMENT_NAME 0
+    done
+fi
+
+# the energy of entering and leaving a state follows from measuring it with two window lengths
+if [[ "$TRANSITIONS_REQUESTED" = true ]]; then
+    for i in "${!SCHEDULED_NAMES[@]}";
+    do
+        if [[ "${SCHEDULED_TYPES[$i]}" == 'states' ]]; then
+            schedule ${SCHEDULED_NAMES[$i]} "${SCHEDULED_OPTIONS[$i]} duration=$((MEASURE_DURATION / 2))" states_half ${SCHEDULED_POLLING[$i]}
+        fi
+    done
+fi
+
+# the cost of refilling caches and TLBs after the wakeup, which grows with the depth of the state and the size of the working set
+if [[ -n "$WORKING_SETS" ]]; then
+    for i in "${!SCHEDULED_NAMES[@]}";
+    do
+        if [[ "${SCHEDULED_TYPES[$i]}" == 'states' ]]; then
+            for SIZE in ${WORKING_SETS//,/ };
+            do
+                schedule ${SCHEDULED_NAMES[$i]}_${SIZE}K "${SCHEDULED_OPTIONS[$i]} working_set=$SIZE" refill ${SCHEDULED_POLLING[$i]}
+            done
+        fi
+    done
+fi
+
+# the energy of each wakeup, and whether waking all CPUs at once (coalesced timers) costs less than spreading the wakeups out
+if [[ -n "$WAKEUP_RATES" && "$(uname -m)" == 'x86_64' ]]; then
+    for i in "${!SCHEDULED_NAMES[@]}";
+    do
+        if [[ "${SCHEDULED_TYPES[$i]}" =~ ^(states|hints)$ && "${SCHEDULED_OPTIONS[$i]}" =~ entry_mechanism=MWAIT ]]; then
+            for RATE in ${WAKEUP_RATES//,/ };
+            do
+                for ALIGNMENT in synchronized staggered;
+                do
+                    schedule ${SCHEDULED_NAMES[$i]}_${ALIGNMENT}_$RATE "mode=periodic ${SCHEDULED_OPTIONS[$i]} wakeup_rate=$RATE wakeup_alignment=$ALIGNMENT" wakeups ${SCHEDULED_POLLING[$i]}
+                done
+            done
+        fi
+    done
+fi
+
+# the Package C-state limit and auto-demotion settings the firmware would otherwise fix, every combination of the given ones
+if [[ (-n "$PKG_CSTATE_LIMITS" || -n "$AUTO_DEMOTIONS") && "$(uname -m)" == 'x86_64' ]]; then
+    PKG_CSTATE_LIMITS=${PKG_CSTATE_LIMITS:--1}
+    AUTO_DEMOTIONS=${AUTO_DEMOTIONS:--1}
+    for i in "${!SCHEDULED_NAMES[@]}";
+    do
+        if [[ "${SCHEDULED_TYPES[$i]}" == 'states' ]]; then
+            for LIMIT in ${PKG_CSTATE_LIMITS//,/ };
+            do
+                for DEMOTION in ${AUTO_DEMOTIONS//,/ };
+                do
+                    NAME=${SCHEDULED_NAMES[$i]}
+                    OPTIONS=${SCHEDULED_OPTIONS[$i]}
+                    if [[ $LIMIT -ge 0 ]]; then
+                        NAME=${NAME}_limit$LIMIT
+                        OPTIONS="$OPTIONS pkg_cstate_limit=$LIMIT"
+                    fi
+                    if [[ $DEMOTION -ge 0 ]]; then
+                        NAME=${NAME}_demotion$DEMOTION
+                        OPTIONS="$OPTIONS auto_demotion=$DEMOTION"
+                    fi
+                    schedule $NAME "$OPTIONS" pkg_cst ${SCHEDULED_POLLING[$i]}
+                done
+            done
         fi
     done
 fi
 
 MEASUREMENT_NAME=cpus_sleep
-mkdir $RESULTS_DIR/$MEASUREMENT_NAME
-for ((i=0; i<=$(getconf _NPROCESSORS_ONLN); i++));
+for ((i=0; i<=$MEASURED_CPU_COUNT; i++));
+do
+    schedule $i "cpus_sleep=$i" $MEASUREMENT_NAME $((MEASURED_CPU_COUNT - i))
+done
+
+# the default policy is 'core', the others are measured separately to compare the savings of each topology level
+for SELECTION in ${CPU_SELECTIONS//,/ };
 do
-    measure $i "cpus_sleep=$i" $MEASUREMENT_NAME
+    for ((i=1; i<$MEASURED_CPU_COUNT; i++));
+    do
+        schedule $i "cpus_sleep=$i cpu_selection=$SELECTION" ${MEASUREMENT_NAME}_$SELECTION $((MEASURED_CPU_COUNT - i))
+    done
 done
 
+# run all configurations, either in order or in shuffled rounds to spread slow drift (e.g. temperature) evenly over them
+ORDER=(${!SCHEDULED_NAMES[@]})
+if [[ $ROUNDS -gt 1 || -n "$SEED" ]]; then
+    SEED=${SEED:-$RANDOM}
+    RANDOM=$SEED
+    echo "$SEED" > $RESULTS_DIR/seed
+fi
+for ((ROUND=1; ROUND<=ROUNDS; ROUND++));
+do
+    if [[ -n "$SEED" ]]; then
+        for ((i=${#ORDER[@]}-1; i>0; i--));
+        do
+            j=$((RANDOM % (i + 1)))
+            TMP=${ORDER[$i]}; ORDER[$i]=${ORDER[$j]}; ORDER[$j]=$TMP
+        done
+    fi
+    for i in "${ORDER[@]}";
+    do
+        NAME=${SCHEDULED_NAMES[$i]}
+        TYPE=${SCHEDULED_TYPES[$i]}
+        echo "$ROUND $TYPE $NAME" >> $RESULTS_DIR/schedule
+        if [[ $ROUNDS -gt 1 ]]; then
+            # the first rounds take one more measurement each if the count cannot be split evenly, so the total stays the same
+            ROUND_COUNT=$((MEASUREMENT_COUNT / ROUNDS + (ROUND <= MEASUREMENT_COUNT % ROUNDS ? 1 : 0)))
+            measure $NAME "measurement_count=$ROUND_COUNT ${SCHEDULED_OPTIONS[$i]}" $TYPE ${SCHEDULED_POLLING[$i]} $RESULTS_DIR/$TYPE/$NAME/round$ROUND
+        else
+            measure $NAME "measurement_count=$MEASUREMENT_COUNT ${SCHEDULED_OPTIONS[$i]}" $TYPE ${SCHEDULED_POLLING[$i]}
+        fi
+        if [[ "$SIGNAL_REQUESTED" = true && $((SECONDS - LAST_SIGNAL)) -ge $SIGNAL_INTERVAL ]]; then
+            SIGNAL_COUNT=$((SIGNAL_COUNT + 1))
+            signal signal_times_$SIGNAL_COUNT
+        fi
+    done
+done
+if [[ $ROUNDS -gt 1 ]]; then
+    for i in "${!SCHEDULED_NAMES[@]}";
+    do
+        merge_rounds $RESULTS_DIR/${SCHEDULED_TYPES[$i]}/${SCHEDULED_NAMES[$i]}
+    done
+fi
+
+if [ "$SIGNAL_REQUESTED" = true ]; then
+    signal signal_times_end
+fi
+
 # cleanup
 if [[ -e /proc/sys/kernel/nmi_watchdog ]]; then
     echo $NMI_WATCHDOG > /proc/sys/kernel/nmi_watchdog
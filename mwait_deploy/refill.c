@@ -0,0 +1,119 @@
+#include "refill.h"
+#include "measure.h"
+#include "consts.h"
+
+#include <linux/kernel.h>
+#include <linux/moduleparam.h>
+#include <linux/vmalloc.h>
+#include <linux/sched/clock.h>
+
+int working_set = 0;
+module_param(working_set, int, 0);
+MODULE_PARM_DESC(working_set, "In 'measure' mode, size of the data every CPU caches before sleeping and touches again after its wakeup, in KiB.\n"
+			      "The time to touch it again after the wakeup is published in 'refill_time', "
+			      "the time to touch it while it is still cached in 'warm_time'. Default is 0, which disables it.");
+
+DEFINE_PER_CPU(u64, warm_time);
+DEFINE_PER_CPU(u64, refill_time);
+
+// every cache line of a working set points to the next one, in random order to defeat the prefetchers
+struct working_set_line
+{
+	struct working_set_line *next;
+	u8 padding[WORKING_SET_LINE_SIZE - sizeof(void *)];
+};
+
+static DEFINE_PER_CPU(struct working_set_line *, lines);
+
+bool is_refilling(void)
+{
+	return operation_mode == MODE_MEASURE && working_set > 0;
+}
+
+static u64 xorshift(u64 *state)
+{
+	*state ^= *state << 13;
+	*state ^= *state >> 7;
+	*state ^= *state << 17;
+	return *state;
+}
+
+// Sattolo's algorithm, the lines form a single cycle so that one traversal touches all of them
+static void link_lines(struct working_set_line *set, u64 count, u64 seed)
+{
+	u64 i, j;
+
+	for (i = 0; i < count; ++i)
+		set[i].next = &set[i];
+	for (i = count - 1; i > 0; --i)
+	{
+		j = xorshift(&seed) % i;
+		swap(set[i].next, set[j].next);
+	}
+}
+
+int prepare_working_sets(void)
+{
+	u64 count;
+	unsigned cpu;
+
+	if (!is_refilling())
+		return 0;
+	if (working_set > MAX_WORKING_SET)
+	{
+		printk(KERN_ERR "Working sets of at most %i KiB are supported, aborting!\n", MAX_WORKING_SET);
+		return 1;
+	}
+
+	count = (u64)working_set * 1024 / sizeof(struct working_set_line);
+	for_each_cpu(cpu, &measured_cpus)
+	{
+		per_cpu(lines, cpu) = vmalloc(count * sizeof(struct working_set_line));
+		if (!per_cpu(lines, cpu))
+		{
+			printk(KERN_ERR "Could not allocate the working set of CPU %u, aborting!\n", cpu);
+			free_working_sets();
+			return 1;
+		}
+		link_lines(per_cpu(lines, cpu), count, 0x9e3779b97f4a7c15ULL ^ cpu);
+	}
+	return 0;
+}
+
+void free_working_sets(void)
+{
+	unsigned cpu;
+
+	for_each_cpu(cpu, &measured_cpus)
+	{
+		vfree(per_cpu(lines, cpu));
+		per_cpu(lines, cpu) = NULL;
+	}
+}
+
+// every load depends on the previous one, so the time is the sum of all cache and TLB misses
+static u64 traverse(int this_cpu)
+{
+	struct working_set_line *first = per_cpu(lines, this_cpu);
+	struct working_set_line *line = first;
+	u64 start = local_clock();
+
+	do
+	{
+		line = READ_ONCE(line->next);
+	} while (line != first);
+
+	return local_clock() - start;
+}
+
+// the first traversal caches the working set, the second one is the reference without misses
+void warm_working_set(int this_cpu)
+{
+	traverse(this_cpu);
+	per_cpu(warm_time, this_cpu) = traverse(this_cpu);
+}
+
+void refill_working_set(int this_cpu)
+{
+	per_cpu(refill_time, this_cpu) = traverse(this_cpu);
+}
@@ -0,0 +1,283 @@
+#include "replay.h"
+#include "measure.h"
+
+#include <linux/kernel.h>
+#include <linux/moduleparam.h>
+#include <linux/kernel_read_file.h>
+#include <linux/vmalloc.h>
+#include <linux/sched/clock.h>
+
+static char *trace_file = NULL;
+module_param(trace_file, charp, 0);
+MODULE_PARM_DESC(trace_file, "In 'replay' mode, path of the idle trace to replay, as written by scripts/convertIdleTrace.py.\n"
+			     "The records of every CPU are replayed on the CPU with the same number, except on the leader, which ends the windows.");
+static char *replay_states = NULL;
+module_param(replay_states, charp, 0);
+MODULE_PARM_DESC(replay_states, "In 'replay' mode, how the idle states of the trace are entered, one entry per state index separated by commas.\n"
+				"'POLL' polls, a number is the hint used with entry_mechanism (the MWAIT hint on x86), e.g. 'POLL,0x00,0x01,0x20'.");
+static int wakeup_rate = 1000;
+module_param(wakeup_rate, int, 0);
+MODULE_PARM_DESC(wakeup_rate, "In 'periodic' mode, how often every measured CPU but the leader is woken up, per second. Default is 1000.");
+static char *wakeup_alignment = "synchronized";
+module_param(wakeup_alignment, charp, 0);
+MODULE_PARM_DESC(wakeup_alignment, "In 'periodic' mode, 'synchronized' wakes all CPUs at the same time, like coalesced timers, "
+				   "'staggered' spreads their wakeups evenly over the period. Default is 'synchronized'.");
+
+// the records of all replaying CPUs, grouped by CPU in the order of the trace
+static struct replay_record *records;
+static struct replay_state states[MAX_REPLAY_STATES];
+static unsigned state_count;
+static DEFINE_PER_CPU(u64, replay_first);
+static DEFINE_PER_CPU(u64, replay_count);
+static DEFINE_PER_CPU(u64, replay_position);
+static u64 wakeup_period;
+static DEFINE_PER_CPU(u64, wakeup_phase);
+
+static int parse_replay_states(void)
+{
+	char token[32];
+	const char *start = replay_states;
+	const char *end;
+	size_t length;
+
+	if (replay_states == NULL)
+	{
+		printk(KERN_ERR "No replay_states given, aborting!\n");
+		return 1;
+	}
+
+	state_count = 0;
+	while (start)
+	{
+		end = strchr(start, ',');
+		length = end ? end - start : strlen(start);
+		if (state_count == MAX_REPLAY_STATES || length >= sizeof(token))
+		{
+			printk(KERN_ERR "Interpreting replay_states failed, at most %i states are supported, aborting!\n", MAX_REPLAY_STATES);
+			return 1;
+		}
+		memcpy(token, start, length);
+		token[length] = '\0';
+
+		if (strcmp(token, "POLL") == 0)
+		{
+			states[state_count].mechanism = ENTRY_MECHANISM_POLL;
+			states[state_count].hint = 0;
+		}
+		else if (kstrtoull(token, 0, &states[state_count].hint) == 0)
+		{
+			states[state_count].mechanism = requested_entry_mechanism;
+		}
+		else
+		{
+			printk(KERN_ERR "Interpreting entry '%s' of replay_states failed, aborting!\n", token);
+			return 1;
+		}
+
+		++state_count;
+		start = end ? end + 1 : NULL;
+	}
+	return 0;
+}
+
+// the leader is woken by the timer ending the window and cannot replay idle periods of its own
+static bool can_replay(u32 cpu)
+{
+	return cpu < MAX_CPUS && cpumask_test_cpu(cpu, &measured_cpus) && !is_leader(cpu);
+}
+
+bool is_replaying(int cpu)
+{
+	if (operation_mode == MODE_PERIODIC)
+		return can_replay(cpu);
+	return records && per_cpu(replay_count, cpu) > 0;
+}
+
+int load_replay_trace(void)
+{
+	void *buf = NULL;
+	struct replay_header *header;
+	struct replay_record *trace;
+	size_t file_size;
+	ssize_t err;
+	u64 i, total = 0, skipped = 0;
+	unsigned cpu;
+
+	if (parse_replay_states())
+		return 1;
+	if (trace_file == NULL)
+	{
+		printk(KERN_ERR "No trace_file given, aborting!\n");
+		return 1;
+	}
+
+	err = kernel_read_file_from_path(trace_file, 0, &buf, MAX_REPLAY_FILE_SIZE, &file_size, READING_UNKNOWN);
+	if (err < 0)
+	{
+		printk(KERN_ERR "Reading idle trace '%s' failed (%zi), aborting!\n", trace_file, err);
+		return 1;
+	}
+
+	header = buf;
+	if (file_size < sizeof(*header) || memcmp(header->magic, REPLAY_MAGIC, sizeof(header->magic)) != 0 ||
+	    header->version != REPLAY_VERSION || header->record_size != sizeof(struct replay_record) ||
+	    header->record_count > (file_size - sizeof(*header)) / sizeof(struct replay_record))
+	{
+		printk(KERN_ERR "'%s' is not a valid idle trace, aborting!\n", trace_file);
+		vfree(buf);
+		return 1;
+	}
+	trace = (struct replay_record *)(header + 1);
+
+	for_each_cpu(cpu, &measured_cpus)
+		per_cpu(replay_count, cpu) = 0;
+	for (i = 0; i < header->record_count; ++i)
+	{
+		if (!can_replay(trace[i].cpu))
+		{
+			++skipped;
+			continue;
+		}
+		if (trace[i].state >= state_count)
+		{
+			printk(KERN_ERR "Idle state %u of the trace has no entry in replay_states, aborting!\n", trace[i].state);
+			vfree(buf);
+			return 1;
+		}
+		++per_cpu(replay_count, trace[i].cpu);
+	}
+
+	for_each_cpu(cpu, &measured_cpus)
+	{
+		per_cpu(replay_first, cpu) = total;
+		per_cpu(replay_position, cpu) = 0;
+		total += per_cpu(replay_count, cpu);
+	}
+	if (total == 0)
+	{
+		printk(KERN_ERR "The idle trace contains no idle periods of measured CPUs other than the leader, aborting!\n");
+		vfree(buf);
+		return 1;
+	}
+
+	records = vmalloc(total * sizeof(struct replay_record));
+	if (!records)
+	{
+		printk(KERN_ERR "Could not allocate memory for the idle trace, aborting!\n");
+		vfree(buf);
+		return 1;
+	}
+	for (i = 0; i < header->record_count; ++i)
+	{
+		if (can_replay(trace[i].cpu))
+		{
+			cpu = trace[i].cpu;
+			records[per_cpu(replay_first, cpu) + per_cpu(replay_position, cpu)++] = trace[i];
+		}
+	}
+	for_each_cpu(cpu, &measured_cpus)
+		per_cpu(replay_position, cpu) = 0;
+	vfree(buf);
+
+	printk(KERN_INFO "Replaying %llu idle periods, %llu of other CPUs are skipped.\n", total, skipped);
+	return 0;
+}
+
+void free_replay_trace(void)
+{
+	vfree(records);
+	records = NULL;
+}
+
+// Every CPU continues with its next record in each window and starts over at the end of its records
+void replay_trace(int this_cpu)
+{
+	struct replay_record *record;
+	struct replay_state *state;
+	u64 busy_end;
+
+	while (is_measurement_ongoing())
+	{
+		record = &records[per_cpu(replay_first, this_cpu) + per_cpu(replay_position, this_cpu)];
+		per_cpu(replay_position, this_cpu) = (per_cpu(replay_position, this_cpu) + 1) % per_cpu(replay_count, this_cpu);
+
+		state = &states[record->state];
+		do_system_specific_idle(this_cpu, state->mechanism, state->hint, record->idle_ns);
+		per_cpu(wakeups, this_cpu) += 1;
+
+		busy_end = local_clock() + record->busy_ns;
+		while (is_measurement_ongoing() && local_clock() < busy_end)
+		{
+		}
+	}
+
+	all_cpus_callback(this_cpu);
+}
+
+int prepare_periodic_wakeups(void)
+{
+	unsigned cpu, index = 0;
+	bool staggered;
+
+	if (wakeup_rate <= 0 || wakeup_rate > MAX_WAKEUP_RATE)
+	{
+		printk(KERN_ERR "Wakeup rates between 1 and %i per second are supported, aborting!\n", MAX_WAKEUP_RATE);
+		return 1;
+	}
+	if (strcmp(wakeup_alignment, "synchronized") == 0)
+	{
+		staggered = false;
+	}
+	else if (strcmp(wakeup_alignment, "staggered") == 0)
+	{
+		staggered = true;
+	}
+	else
+	{
+		printk(KERN_ERR "Wakeup alignment '%s' unknown, aborting!\n", wakeup_alignment);
+		return 1;
+	}
+
+	wakeup_period = 1000000000 / wakeup_rate;
+	for_each_cpu(cpu, &measured_cpus)
+	{
+		per_cpu(wakeup_phase, cpu) = 0;
+		if (staggered && can_replay(cpu))
+			per_cpu(wakeup_phase, cpu) = wakeup_period * index++ / (cpus_present - 1);
+	}
+
+	printk(KERN_INFO "Waking up every CPU but the leader every %llu ns, %s.\n", wakeup_period, wakeup_alignment);
+	return 0;
+}
+
+// The wakeups follow a grid of the clock shared by all CPUs, so their alignment does not drift with the time each wakeup takes
+// If a wakeup took longer than the period, the CPU continues with the next point of the grid
+void wake_periodically(int this_cpu)
+{
+	enum entry_mechanism mechanism = per_cpu(cpu_entry_mechanism, this_cpu);
+	u64 hint = get_entry_hint(this_cpu);
+	u64 next, now;
+
+	now = local_clock();
+	next = now - now % wakeup_period + per_cpu(wakeup_phase, this_cpu);
+	while (is_measurement_ongoing())
+	{
+		now = local_clock();
+		while (next <= now)
+			next += wakeup_period;
+
+		do_system_specific_idle(this_cpu, mechanism, hint, next - now);
+		per_cpu(wakeups, this_cpu) += 1;
+	}
+
+	all_cpus_callback(this_cpu);
+}
+
+// Whether the CPU was woken at another rate than requested, e.g. because a wakeup took longer than the period or interrupts ended idle periods early
+// The window starts and ends between two points of the grid, and the last idle period is ended by the window, so the count may be off by one
+bool missed_periodic_wakeups(int cpu, u64 window_ns)
+{
+	u64 expected = window_ns / wakeup_period;
+
+	return per_cpu(wakeups, cpu) + 1 < expected || per_cpu(wakeups, cpu) > expected + 2;
+}
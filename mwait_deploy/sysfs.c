@@ -1,14 +1,65 @@
 #include "sysfs.h"
+#include "measure.h"
+#include "refill.h"
 
 #include <linux/kernel.h>
+#include <linux/cpumask.h>
+#include <linux/slab.h>
 #include <asm/page.h>
 
+struct attribute performance_cpus_attribute = {.name = "performance_cpus", .mode = 0444};
+struct attribute efficiency_cpus_attribute = {.name = "efficiency_cpus", .mode = 0444};
+
+static struct attribute *hybrid_stats_attributes[] = {
+    &performance_cpus_attribute,
+    &efficiency_cpus_attribute,
+    NULL};
+
+static umode_t hybrid_stats_visible(struct kobject *kobj, struct attribute *attr, int index)
+{
+	return is_hybrid() ? attr->mode : 0;
+}
+
+const struct attribute_group hybrid_stats_group = {
+    .is_visible = hybrid_stats_visible,
+    .attrs = hybrid_stats_attributes};
+
+// the measured CPUs of one core type as a list like measured_cpus
+static ssize_t format_core_type_cpus(enum core_type type, char *buf)
+{
+	cpumask_var_t cpus;
+	ssize_t len;
+	unsigned cpu;
+
+	if (!zalloc_cpumask_var(&cpus, GFP_KERNEL))
+		return -ENOMEM;
+	for_each_cpu(cpu, &measured_cpus)
+	{
+		if (get_core_type(cpu) == type)
+			cpumask_set_cpu(cpu, cpus);
+	}
+	len = cpumap_print_to_pagebuf(true, buf, cpus);
+	free_cpumask_var(cpus);
+	return len;
+}
+
+static ssize_t output_hybrid_stats(struct attribute *attr, char *buf)
+{
+	if (strcmp(attr->name, "performance_cpus") == 0)
+		return format_core_type_cpus(CORE_TYPE_PERFORMANCE, buf);
+	if (strcmp(attr->name, "efficiency_cpus") == 0)
+		return format_core_type_cpus(CORE_TYPE_EFFICIENCY, buf);
+	return 0;
+}
+
 struct signal_stat signal_stat;
 
 struct attribute signal_times_attribute = {.name = "signal_times", .mode = 0444};
+struct attribute signal_code_attribute = {.name = "signal_code", .mode = 0444};
 
 static struct attribute *signal_stat_attributes[] = {
     &signal_times_attribute,
+    &signal_code_attribute,
     NULL};
 static struct attribute_group signal_stat_group = {
     .attrs = signal_stat_attributes};
@@ -20,7 +71,9 @@ ssize_t show_signal_times(struct kobject *kobj, struct attribute *attr, char *bu
 {
 	struct signal_stat *stat = container_of(kobj, struct signal_stat, kobject);
 	if (strcmp(attr->name, "signal_times") == 0)
-		return format_array_into_buffer(stat->signal_times, SIGNAL_EDGE_COUNT + 2, buf);
+		return format_array_into_buffer(stat->signal_times, stat->level_count + 1, buf);
+	if (strcmp(attr->name, "signal_code") == 0)
+		return format_array_into_buffer(stat->signal_code, stat->level_count, buf);
 	return 0;
 }
 
@@ -44,12 +97,162 @@ void cleanup_signal_times(void)
 	kobject_del(&(signal_stat.kobject));
 }
 
+struct discovery_stat discovery_stat;
+
+struct attribute discovery_hints_attribute = {.name = "hints", .mode = 0444};
+
+static struct attribute *discovery_stat_attributes[] = {
+    &discovery_hints_attribute,
+    NULL};
+static struct attribute_group discovery_stat_group = {
+    .attrs = discovery_stat_attributes};
+static const struct attribute_group *discovery_stat_groups[] = {
+    &discovery_stat_group,
+    &hybrid_stats_group,
+    NULL};
+
+ssize_t show_discovered_hints(struct kobject *kobj, struct attribute *attr, char *buf)
+{
+	struct discovery_stat *stat = container_of(kobj, struct discovery_stat, kobject);
+	if (strcmp(attr->name, "hints") == 0)
+		return format_array_into_buffer(stat->hints, stat->hint_count, buf);
+	return output_hybrid_stats(attr, buf);
+}
+
+static const struct sysfs_ops discovery_sysfs_ops = {
+    .show = show_discovered_hints,
+    .store = ignore_write};
+static const struct kobj_type discovery_ktype = {
+    .sysfs_ops = &discovery_sysfs_ops,
+    .release = release,
+    .default_groups = discovery_stat_groups};
+
+void publish_discovered_hints(void)
+{
+	int err = kobject_init_and_add(&(discovery_stat.kobject), &discovery_ktype, NULL, "mwait_measurements");
+	if (err)
+		printk(KERN_ERR "Could not properly initialize discovery stat structure in the sysfs.");
+}
+
+void cleanup_discovered_hints(void)
+{
+	kobject_del(&(discovery_stat.kobject));
+}
+
+struct benchmark_stat benchmark_stat;
+
+struct attribute benchmark_iterations_attribute = {.name = "iterations", .mode = 0444};
+struct attribute benchmark_sync_attribute = {.name = "sync", .mode = 0444};
+struct attribute benchmark_window_end_attribute = {.name = "window_end", .mode = 0444};
+struct attribute benchmark_wakeup_attribute = {.name = "wakeup", .mode = 0444};
+struct attribute benchmark_cpu_snapshot_attribute = {.name = "cpu_snapshot", .mode = 0444};
+struct attribute benchmark_global_snapshot_attribute = {.name = "global_snapshot", .mode = 0444};
+struct attribute benchmark_format_attribute = {.name = "format", .mode = 0444};
+
+static struct attribute *benchmark_stat_attributes[] = {
+    &benchmark_iterations_attribute,
+    &benchmark_sync_attribute,
+    &benchmark_window_end_attribute,
+    &benchmark_wakeup_attribute,
+    &benchmark_cpu_snapshot_attribute,
+    &benchmark_global_snapshot_attribute,
+    &benchmark_format_attribute,
+    NULL};
+static struct attribute_group benchmark_stat_group = {
+    .attrs = benchmark_stat_attributes};
+static const struct attribute_group *benchmark_stat_groups[] = {
+    &benchmark_stat_group,
+    NULL};
+
+// every phase shows its minimum, median and 99th percentile in nanoseconds, one per line
+ssize_t show_benchmark_results(struct kobject *kobj, struct attribute *attr, char *buf)
+{
+	struct benchmark_stat *stat = container_of(kobj, struct benchmark_stat, kobject);
+	int phase;
+
+	if (strcmp(attr->name, "iterations") == 0)
+		return format_array_into_buffer(&stat->iterations, 1, buf);
+	for (phase = 0; phase < BENCHMARK_PHASE_COUNT; ++phase)
+	{
+		if (strcmp(attr->name, benchmark_phase_names[phase]) == 0)
+			return format_array_into_buffer(stat->results[phase], BENCHMARK_STATISTIC_COUNT, buf);
+	}
+	return 0;
+}
+
+static const struct sysfs_ops benchmark_sysfs_ops = {
+    .show = show_benchmark_results,
+    .store = ignore_write};
+static const struct kobj_type benchmark_ktype = {
+    .sysfs_ops = &benchmark_sysfs_ops,
+    .release = release,
+    .default_groups = benchmark_stat_groups};
+
+void publish_benchmark_results(void)
+{
+	int err = kobject_init_and_add(&(benchmark_stat.kobject), &benchmark_ktype, NULL, "mwait_measurements");
+	if (err)
+		printk(KERN_ERR "Could not properly initialize benchmark stat structure in the sysfs.");
+}
+
+void cleanup_benchmark_results(void)
+{
+	kobject_del(&(benchmark_stat.kobject));
+}
+
 struct attribute start_time_attribute = {.name = "start_time", .mode = 0444};
 struct attribute end_time_attribute = {.name = "end_time", .mode = 0444};
 struct attribute repetitions_attribute = {.name = "repetitions", .mode = 0444};
+struct attribute interfered_attribute = {.name = "interfered", .mode = 0444};
+struct attribute measured_cpus_attribute = {.name = "measured_cpus", .mode = 0444};
+struct attribute contaminating_cpus_attribute = {.name = "contaminating_cpus", .mode = 0444};
+struct attribute contaminated_counters_attribute = {.name = "contaminated_counters", .mode = 0444};
+
+struct attribute sleeping_cpus_attribute = {.name = "sleeping_cpus", .mode = 0444};
+
+static struct attribute *selection_stats_attributes[] = {
+    &sleeping_cpus_attribute,
+    NULL};
+
+const struct attribute_group selection_stats_group = {
+    .attrs = selection_stats_attributes};
 
 struct attribute cpu_wakeup_time_attribute = {.name = "wakeup_time", .mode = 0444};
 struct attribute cpu_wakeups_attribute = {.name = "wakeups", .mode = 0444};
+struct attribute cpu_interrupts_attribute = {.name = "interrupts", .mode = 0444};
+struct attribute cpu_nmis_attribute = {.name = "nmis", .mode = 0444};
+
+static const char *core_type_names[] = {
+    [CORE_TYPE_UNKNOWN] = "unknown",
+    [CORE_TYPE_PERFORMANCE] = "performance",
+    [CORE_TYPE_EFFICIENCY] = "efficiency"};
+
+struct attribute cpu_core_type_attribute = {.name = "core_type", .mode = 0444};
+
+static struct attribute *core_type_stats_attributes[] = {
+    &cpu_core_type_attribute,
+    NULL};
+
+const struct attribute_group core_type_stats_group = {
+    .is_visible = hybrid_stats_visible,
+    .attrs = core_type_stats_attributes};
+
+struct attribute cpu_warm_time_attribute = {.name = "warm_time", .mode = 0444};
+struct attribute cpu_refill_time_attribute = {.name = "refill_time", .mode = 0444};
+
+static struct attribute *refill_stats_attributes[] = {
+    &cpu_warm_time_attribute,
+    &cpu_refill_time_attribute,
+    NULL};
+
+static umode_t refill_stats_visible(struct kobject *kobj, struct attribute *attr, int index)
+{
+	return is_refilling() ? attr->mode : 0;
+}
+
+const struct attribute_group refill_stats_group = {
+    .is_visible = refill_stats_visible,
+    .attrs = refill_stats_attributes};
 
 ssize_t format_array_into_buffer(u64 *array, int len, char *buf)
 {
@@ -77,6 +280,22 @@ ssize_t format_array_into_buffer_signed(u64 *array, int len, char *buf)
 	return bytes_written;
 }
 
+// lists the package level counters that also include the work of housekeeping CPUs, one per line
+static ssize_t format_contaminated_counters(char *buf)
+{
+	const char **counters = get_package_level_counters();
+	int bytes_written = 0;
+
+	if (cpumask_empty(&contaminating_cpus))
+		return 0;
+
+	for (int i = 0; counters[i] && bytes_written < PAGE_SIZE; ++i)
+	{
+		bytes_written += scnprintf(buf + bytes_written, PAGE_SIZE - bytes_written, "%s\n", counters[i]);
+	}
+	return bytes_written;
+}
+
 ssize_t ignore_write(struct kobject *kobj, struct attribute *attr, const char *buf, size_t count)
 {
 	return count;
@@ -95,6 +314,18 @@ ssize_t show_pkg_stats(struct kobject *kobj, struct attribute *attr, char *buf)
 		return format_array_into_buffer(stat->end_time, measurement_count, buf);
 	if (strcmp(attr->name, "repetitions") == 0)
 		return format_array_into_buffer(stat->repetitions, measurement_count, buf);
+	if (strcmp(attr->name, "interfered") == 0)
+		return format_array_into_buffer(stat->interfered, measurement_count, buf);
+	if (strcmp(attr->name, "measured_cpus") == 0)
+		return cpumap_print_to_pagebuf(true, buf, &measured_cpus);
+	if (strcmp(attr->name, "contaminating_cpus") == 0)
+		return cpumap_print_to_pagebuf(true, buf, &contaminating_cpus);
+	if (strcmp(attr->name, "sleeping_cpus") == 0)
+		return cpumap_print_to_pagebuf(true, buf, &sleeping_cpus);
+	if (strcmp(attr->name, "contaminated_counters") == 0)
+		return format_contaminated_counters(buf);
+	if (strcmp(attr->name, "performance_cpus") == 0 || strcmp(attr->name, "efficiency_cpus") == 0)
+		return output_hybrid_stats(attr, buf);
 	return output_pkg_attributes(stat, attr, buf);
 }
 
@@ -105,5 +336,15 @@ ssize_t show_cpu_stats(struct kobject *kobj, struct attribute *attr, char *buf)
 		return format_array_into_buffer_signed(stat->wakeup_time, measurement_count, buf);
 	if (strcmp(attr->name, "wakeups") == 0)
 		return format_array_into_buffer(stat->wakeups, measurement_count, buf);
+	if (strcmp(attr->name, "interrupts") == 0)
+		return format_array_into_buffer(stat->interrupts, measurement_count, buf);
+	if (strcmp(attr->name, "nmis") == 0)
+		return format_array_into_buffer(stat->nmis, measurement_count, buf);
+	if (strcmp(attr->name, "warm_time") == 0)
+		return format_array_into_buffer(stat->warm_time, measurement_count, buf);
+	if (strcmp(attr->name, "refill_time") == 0)
+		return format_array_into_buffer(stat->refill_time, measurement_count, buf);
+	if (strcmp(attr->name, "core_type") == 0)
+		return scnprintf(buf, PAGE_SIZE, "%s\n", core_type_names[get_core_type(stat - cpu_stats)]);
 	return output_cpu_attributes(stat, attr, buf);
 }
@@ -0,0 +1,117 @@
+#!/usr/bin/env python3
+
+"""
+Converts a capture of the power:cpu_idle tracepoint into the idle trace the kernel module replays in 'replay' mode.
+
+Capture it on the system whose idle pattern should be reproduced, e.g. with
+    trace-cmd record -e power:cpu_idle sleep 10 && trace-cmd report > idle.txt
+or by reading /sys/kernel/tracing/trace after enabling the event.
+Every idle period becomes a record of its state, its length and the busy time until the next idle period of the same CPU.
+"""
+
+import os, sys
+import re
+import getopt
+import struct
+
+scriptDir = os.path.dirname(__file__)
+outputDir = os.path.normpath(os.path.join(scriptDir, '..', 'output'))
+traceFile = os.path.join(outputDir, 'idle_trace.bin')
+
+replayMagic = b'MWREPLAY'
+replayVersion = 1
+headerFormat = '<8sIIQ'
+recordFormat = '<IIQQ'
+
+# the state of the event leaving an idle state, (u32)-1
+exitState = 4294967295
+eventPattern = re.compile(r'\s(\d+\.\d+):\s+cpu_idle:\s+state=(\d+)\s+cpu_id=(\d+)')
+
+def help():
+	print('Syntax: convertIdleTrace.py [-o <file>] [-m <state>=<state>,...] <trace report>')
+	print('    -o: Write the idle trace to this file instead of output/idle_trace.bin')
+	print('    -m: Replay idle states as other ones, e.g. 3=2 to see what choosing state 2 instead of 3 would have cost')
+
+
+# idle periods per CPU as [state, idle_ns, busy_ns]
+def readTrace(path):
+	periods = {}
+	entered = {}
+	lastExit = {}
+	with open(path) as file:
+		for line in file:
+			match = eventPattern.search(line)
+			if not match:
+				continue
+			time = int(round(float(match.group(1)) * 1000000000))
+			state = int(match.group(2))
+			cpu = int(match.group(3))
+
+			if state == exitState:
+				if cpu in entered:
+					enterState, enterTime = entered.pop(cpu)
+					periods.setdefault(cpu, []).append([enterState, time - enterTime, 0])
+					lastExit[cpu] = time
+			else:
+				# the previous idle period is followed by busy time until this one starts
+				if cpu in lastExit:
+					periods[cpu][-1][2] = time - lastExit.pop(cpu)
+				entered[cpu] = (state, time)
+	return periods
+
+def mapStates(periods, stateMap):
+	for cpuPeriods in periods.values():
+		for period in cpuPeriods:
+			period[0] = stateMap.get(period[0], period[0])
+
+def writeTrace(path, periods):
+	records = [ (cpu, state, idle, busy) for cpu in sorted(periods) for state, idle, busy in periods[cpu] ]
+	with open(path, 'wb') as file:
+		file.write(struct.pack(headerFormat, replayMagic, replayVersion, struct.calcsize(recordFormat), len(records)))
+		for record in records:
+			file.write(struct.pack(recordFormat, *record))
+	return len(records)
+
+def printSummary(periods):
+	for cpu in sorted(periods):
+		cpuPeriods = periods[cpu]
+		idle = sum(period[1] for period in cpuPeriods)
+		busy = sum(period[2] for period in cpuPeriods)
+		states = {}
+		for period in cpuPeriods:
+			states[period[0]] = states.get(period[0], 0) + 1
+		print('CPU ' + str(cpu) + ': ' + str(len(cpuPeriods)) + ' idle periods, mean ' + str(round(idle / len(cpuPeriods) / 1000, 1)) +
+		      ' us idle, ' + str(round(idle / max(idle + busy, 1) * 100, 1)) + ' % idle, states ' +
+		      ', '.join(str(state) + ': ' + str(count) for state, count in sorted(states.items())))
+
+
+def main():
+	options, args = getopt.getopt(sys.argv[1:], 'o:m:h')
+	outputFile = traceFile
+	stateMap = {}
+	for option, value in options:
+		if option == '-o':
+			outputFile = value
+		elif option == '-m':
+			for mapping in value.split(','):
+				source, target = mapping.split('=')
+				stateMap[int(source)] = int(target)
+		elif option == '-h':
+			help()
+			exit(0)
+	if len(args) != 1:
+		help()
+		exit(1)
+
+	periods = readTrace(args[0])
+	if not periods:
+		print('No cpu_idle events found in ' + args[0], file=sys.stderr)
+		exit(1)
+	mapStates(periods, stateMap)
+	printSummary(periods)
+	os.makedirs(os.path.dirname(os.path.abspath(outputFile)), exist_ok=True)
+	count = writeTrace(outputFile, periods)
+	print('Wrote ' + str(count) + ' idle periods to ' + outputFile)
+	exit(0)
+
+main()
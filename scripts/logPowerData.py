@@ -6,15 +6,24 @@ import sys, os, signal
 import statistics
 import getopt
 import csv
+import struct
+import tempfile, shutil
 from decimal import Decimal
 
 smartdroidPath = os.environ.get('SMARTDROID_PATH', './smartdroid')
-if not os.path.isfile(smartdroidPath):
-	print("To use the ODROID Smart Power, the 'smartdroid' tool is required.\n"
-		"Please supply the path of the smartdroid binary by setting the SMARTDROID_PATH environment variable!")
-	exit(1)
 
 scriptDir = os.path.dirname(__file__)
+outputDir = os.path.normpath(os.path.join(scriptDir, '..', 'output'))
+
+# the native logger keeps the device open instead of starting smartdroid for every value, see logger/
+loggerPath = os.path.normpath(os.path.join(scriptDir, '..', 'logger', 'powerlog'))
+loggerDevice = os.environ.get('POWER_DEVICE', 'smartpower')
+
+def checkSmartdroid():
+	if not os.path.isfile(smartdroidPath):
+		print("To use the ODROID Smart Power without the native logger, the 'smartdroid' tool is required.\n"
+			"Please supply the path of the smartdroid binary by setting the SMARTDROID_PATH environment variable!")
+		exit(1)
 
 """
 Python does not automatically raise a KeyboardInterrupt on a SIGINT in all cases.
@@ -65,7 +74,6 @@ def getMeasurementPeriod():
 
 
 def logToFile(log):
-	outputDir = os.path.normpath(os.path.join(scriptDir, '..', 'output'))
 	csvFile = os.path.join(outputDir, 'power_log.csv')
 
 	with open(csvFile, 'w') as file:
@@ -102,6 +110,54 @@ def logPower():
 	logToFile(log)
 
 
+# layout of logger/ring.h
+ringHeader = struct.Struct('<8sIIQQ')
+ringRecord = struct.Struct('<qd')
+
+def readRing(ringFile):
+	with open(ringFile, 'rb') as file:
+		data = file.read()
+	magic, _, recordSize, capacity, count = ringHeader.unpack_from(data)
+	if magic != b'PWRRING1' or recordSize != ringRecord.size:
+		print('Unknown format of ' + ringFile, file=sys.stderr)
+		exit(1)
+
+	# if the ring was full, the oldest values were overwritten
+	first = max(count - capacity, 0)
+	if first > 0:
+		print('Power log overflowed, the first ' + str(first) + ' values are lost', file=sys.stderr)
+	log = { 'time': [], 'power': [] }
+	for i in range(first, count):
+		time, power = ringRecord.unpack_from(data, ringHeader.size + (i % capacity) * ringRecord.size)
+		log['time'].append(time)
+		log['power'].append(power)
+	return log
+
+def logPowerNative():
+	# the ring is kept outside of output/, which measure.sh clears while the logger is running
+	ringDir = tempfile.mkdtemp(prefix='power_log')
+	ringFile = os.path.join(ringDir, 'power_log.ring')
+	logger = subprocess.Popen([loggerPath, '-d', loggerDevice, ringFile])
+	try:
+		logger.wait()
+	except KeyboardInterrupt:
+		logger.send_signal(signal.SIGINT)
+		logger.wait()
+
+	log = readRing(ringFile)
+	shutil.rmtree(ringDir)
+	if not log['time']:
+		print('No power values were logged', file=sys.stderr)
+		exit(1)
+
+	# timestamps are CLOCK_MONOTONIC_RAW in nanoseconds, limit the precision to microseconds
+	timeOffset = log['time'][0]
+	for i in range(0, len(log['time'])):
+		log['time'][i] = round(Decimal(log['time'][i] - timeOffset) / 1000000000, 6)
+
+	logToFile(log)
+
+
 def main():
 	if os.geteuid() != 0:
 		print("To read any values from the ODROID Smart Power, root privileges are required. Please run as root!")
@@ -109,11 +165,19 @@ def main():
 
 	_, args = getopt.getopt(sys.argv[1:], '')
 	if 'period' in args:
+		checkSmartdroid()
 		period = getMeasurementPeriod()
 		print(period)
 		exit(0)
-	
-	logPower()
+
+	if os.path.isfile(loggerPath):
+		logPowerNative()
+	elif loggerDevice != 'smartpower':
+		print("Measuring devices other than the ODROID Smart Power require the native logger, please build it with 'make' in the logger folder!")
+		exit(1)
+	else:
+		checkSmartdroid()
+		logPower()
 	exit(0)
 
 main()
\ No newline at end of file
@@ -54,19 +54,17 @@ def addPkgCstates(means, index, cstates, dir, measurementName):
     for state in cstates:
         means[state].append((series[state]/series[totalTscFileName]).mean())
 
+# only the measured CPUs have a directory, which do not have to be numbered consecutively
+def getCpuDirNames(dir):
+    return sorted([ e.name for e in os.scandir(dir) if e.is_dir() and re.fullmatch(r'cpu\d+', e.name) ], key=sortingFunction)
+
 def getCoreCount(dir):
-    i = 0
-    while True:
-        cpuDirName = 'cpu'+str(i)
-        if not os.path.exists(os.path.join(dir, cpuDirName)):
-            break
-        i += 1
-    return i
+    return len(getCpuDirNames(dir))
 
 def calculateCoreAverage(dir, state, coreCount, unspecified):
     series = None
-    for i in range(0, coreCount):
-        data = pd.read_csv(os.path.join(dir, 'cpu'+str(i), state), header=None).iloc[:,0]
+    for i, cpuDirName in enumerate(getCpuDirNames(dir)):
+        data = pd.read_csv(os.path.join(dir, cpuDirName, state), header=None).iloc[:,0]
         if series is None:
             series = data
         else:
@@ -124,16 +122,27 @@ def main():
     except FileNotFoundError:
         pass
 
-    cpusDirName = 'cpus_sleep'
+    correctedPowerFileName = 'power_corrected'
 
     try:
-        plot = plotPkgMeasurements(cpusDirName, powerFileName)
-        plot.set_ylim(ymin=0)
-        plot.set_ylabel("Watts")
-        plot.figure.savefig(os.path.join(outputDir, powerFileName + '_by_' + cpusDirName + '.pdf'))
+        plot = plotPkgMeasurements(statesDirName, correctedPowerFileName)
+        plot.set_ylabel('Watts')
+        plot.figure.savefig(os.path.join(outputDir, correctedPowerFileName + '_by_' + statesDirName + '.pdf'))
     except FileNotFoundError:
         pass
 
+    # one directory per CPU selection policy, 'cpus_sleep' for the default one
+    cpusDirNames = [ e.name for e in os.scandir(resultsDir) if e.is_dir() and e.name.startswith('cpus_sleep') ] if os.path.isdir(resultsDir) else []
+
+    for cpusDirName in cpusDirNames:
+        try:
+            plot = plotPkgMeasurements(cpusDirName, powerFileName)
+            plot.set_ylim(ymin=0)
+            plot.set_ylabel("Watts")
+            plot.figure.savefig(os.path.join(outputDir, powerFileName + '_by_' + cpusDirName + '.pdf'))
+        except FileNotFoundError:
+            pass
+
     wakeupTimeFileName = 'wakeup_time'
     wakeupTimePath = os.path.join('cpu0', wakeupTimeFileName)
     wakeupTimeDivisor = 1000    # nanoecond to microsecond
@@ -1,10 +1,11 @@
 #!/usr/bin/env python3
 
 import pandas as pd
+import numpy as np
 import os, sys
-from dataclasses import dataclass
 from decimal import Decimal
 import csv
+import re
 import statistics
 
 scriptDir = os.path.dirname(__file__)
@@ -12,6 +13,8 @@ outputDir = os.path.normpath(os.path.join(scriptDir, '..', 'output'))
 resultsDir = os.path.join(outputDir, 'results')
 
 signalTimesFile = os.path.join(resultsDir, 'signal_times')
+signalCodeFile = os.path.join(resultsDir, 'signal_code')
+syncFile = os.path.join(resultsDir, 'sync')
 durationFile = os.path.join(resultsDir, 'duration')
 powerLogFile = os.path.join(outputDir, 'power_log.csv')
 
@@ -24,109 +27,171 @@ def decimalConverter(value):
 
 powerLog = None
 
-
-@dataclass
-class PowerIntervall:
-	min: float
-	max: float
-	isRising: bool
-
-	def __contains__(self, value):
-		return value >= self.min and value <= self.max
-	
-	def below(self, value):
-		return self.min <= value
-	
-	def above(self, value):
-		return self.max >= value
-
-def getPowerIntervall(time):
-	i = 0
-	nextTime = powerLog['time'][0]
-	while nextTime <= time:
-		i += 1
-		nextTime = powerLog['time'][i]
-	powerValues = [ powerLog['power'][i-1], powerLog['power'][i] ]
-	return PowerIntervall(min(powerValues), max(powerValues), (powerValues[1] - powerValues[0]) >= 0)
-		
-
-@dataclass
-class PowerPattern:
-	pattern: list
-	period: Decimal
-
-	def __len__(self):
-		return len(self.pattern)
-
-	def fitsSequence(self, sequence):
-		if len(sequence) is not len(self)+1:
-			return False 
-		
-		risingStartEdge = self.pattern[0] > 0
-		startValue = sequence[0].min if risingStartEdge else sequence[0].max
-		for i in range(0, len(self.pattern)):
-			risingEdge = self.pattern[i] > 0
-			if risingEdge:
-				value = sequence[i].min + startValue * self.pattern[i]
-				if not sequence[i+1].above(value):
-					return False
-			else:
-				value = sequence[i].max + startValue * self.pattern[i]
-				if not sequence[i+1].below(value):
-					return False
-		return True
-
-def generatePattern(edgeCount, threshold):
-	pattern = []
-	sign = -1
-	for _ in range(0, edgeCount):
-		pattern.append(sign * threshold)
-		sign *= -1
-	return pattern
-
-powerPattern = PowerPattern(generatePattern(3, Decimal(0.1)), Decimal(duration))
-
-
-@dataclass
-class ApproximateTime:
-	time: Decimal
-	error: Decimal
-
-	def __rsub__(self, other):
-		return ApproximateTime(other - self.time, self.error)
-
-	def __le__(self, other):
-		return self.time + self.error <= other
-	
-	def __ge__(self, other):
-		return self.time - self.error >= other
-
-def getNextTime(time):
-	nextTime = powerLog['time'][0]
-	i = 1
-	while nextTime <= time and i < len(powerLog):
-		nextTime = powerLog['time'][i]
-		i += 1
-	return nextTime
-
-def seekPattern():
-	startTime = powerLog['time'][0]
-	sequence = [ 0 ] * (len(powerPattern)+1)
-	
-	while startTime + (len(sequence)-1) * powerPattern.period < powerLog['time'][len(powerLog)-1]:
-		for i in range(0, len(sequence)):
-			sequence[i] = getPowerIntervall(startTime + i * powerPattern.period)
-		timeStep = 1 << 20	# some big number to work down from
-		for i in range(0, len(sequence)):
-			time = startTime + i * powerPattern.period
-			stepSize = getNextTime(time) - time
-			if stepSize < timeStep:
-				timeStep = stepSize
-		if powerPattern.fitsSequence(sequence):
-			return ApproximateTime(startTime+timeStep/2, timeStep/2)
-		startTime += timeStep
-	
-	return None
+# the measuring devices report the average power since their previous value, so every value is stamped a period late
+def getMeterPeriod():
+	return np.median(np.diff(powerLog['time'].astype(float).to_numpy()))
+
+
+# the signature as the measuring device records it, sampled every step seconds from its first edge: +1 while polling and
+# -1 while sleeping, averaged over the period before each sample, so the lag of the averaging does not shift the sync points
+def getSignature(signalTimes, signalCode, step, period):
+	edges = signalTimes - signalTimes[0]
+	levels = np.array([ 1 if level else -1 for level in signalCode ])
+	integral = np.concatenate(([0], np.cumsum(levels * np.diff(edges))))
+	sampleTimes = np.arange(int(np.ceil((edges[-1] + period) / step))) * step
+	signature = np.interp(sampleTimes, edges, integral) - np.interp(sampleTimes - period, edges, integral)
+	signature = signature / period if period > 0 else np.interp(sampleTimes, edges[:-1], levels, right=0)
+	# without its mean, a constant offset of the power does not change the correlation
+	return signature - signature.mean()
+
+# correlation[k] = sum(values[k+j] * signature[j]), calculated via FFT in O(N log N)
+def crossCorrelate(values, signature):
+	n = 1 << int(np.ceil(np.log2(len(values) + len(signature))))
+	correlation = np.fft.irfft(np.fft.rfft(values, n) * np.conj(np.fft.rfft(signature, n)), n)
+	return correlation[:max(len(values) - len(signature) + 1, 0)]
+
+def findPeaks(correlation, count, width):
+	correlation = correlation.copy()
+	peaks = []
+	for _ in range(count):
+		k = int(np.argmax(correlation))
+		if correlation[k] == -np.inf:
+			break
+		peaks.append(k)
+		correlation[max(k - width, 0):k + width + 1] = -np.inf
+	return peaks
+
+# seconds to which the sync points are refined
+syncResolution = 0.0001
+
+# sub-sample position of a peak, from the shift within a step around it every syncResolution seconds at which the signature
+# best fits the power log values inside it, the grid and a parabola through the broad peak of an averaged signature miss most of it
+# the signature is stretched by the rate of the clock of the power log relative to the measured system
+def refinePeak(logTimes, logPower, signature, fineStep, logTime, step, rate):
+	signatureTimes = np.arange(len(signature)) * fineStep * rate
+	inside = (logTimes >= logTime + step) & (logTimes <= logTime + signatureTimes[-1] - step)
+	values = logPower[inside] - logPower[inside].mean()
+	shifts = np.arange(-step, step + syncResolution, syncResolution)
+	models = np.interp(logTimes[inside] - logTime - shifts[:, None], signatureTimes, signature)
+	models -= models.mean(axis=1)[:, None]
+	covariances = models @ values
+	fits = covariances * np.abs(covariances) / np.maximum((models * models).sum(axis=1), np.finfo(float).tiny)
+	return logTime + shifts[int(np.argmax(fits))]
+
+# how much the peak stands out from all correlations outside of it, apart from the excluded ranges
+def peakQuality(correlation, k, width, excluded=[]):
+	outside = np.ones(len(correlation), dtype=bool)
+	outside[max(k - width, 0):k + width + 1] = False
+	for first, last in excluded:
+		outside[max(first, 0):max(last, 0)] = False
+	if not outside.any() or np.max(np.abs(correlation[outside])) == 0:
+		return np.inf
+	return correlation[k] / np.max(np.abs(correlation[outside]))
+
+signalCandidates = 5
+# highest clock drift of the power logger relative to the measured system that is searched for
+maxClockDrift = 0.001
+minSignalQuality = 2
+
+# follows the signatures after the first one, each is searched around where the clock model so far predicts it
+def trackSignals(correlations, signals, first, step, width):
+	positions = [ (0, first) ]
+	for i in range(1, len(signals)):
+		(lastIndex, last) = positions[-1]
+		rate = 1
+		if len(positions) > 1:
+			(previousIndex, previous) = positions[-2]
+			rate = (last - previous) / ((signals[lastIndex][0] - signals[previousIndex][0]) / step)
+		distance = (signals[i][0] - signals[lastIndex][0]) / step
+		predicted = int(last + distance * rate)
+		tolerance = int(np.ceil(distance * maxClockDrift)) + width
+		begin = max(predicted - tolerance, 0)
+		end = min(predicted + tolerance + 1, len(correlations[i]))
+		if begin >= end:
+			continue
+		positions.append((i, begin + int(np.argmax(correlations[i][begin:end]))))
+	return positions
+
+# finds the signatures in the power log, returns the sync points as pairs of the time of the first edge on the measured system and in the log
+def findSyncPoints(signalCode, signals):
+	logTimes = powerLog['time'].astype(float).to_numpy()
+	logPower = powerLog['power'].astype(float).to_numpy()
+
+	levelDuration = min([ np.min(np.diff(signalTimes)) for signalTimes in signals ])
+	meterPeriod = getMeterPeriod()
+	step = min(meterPeriod, levelDuration / 4)
+	grid = np.arange(logTimes[0], logTimes[-1], step)
+	values = np.interp(grid, logTimes, logPower)
+	values -= values.mean()
+
+	signatures = [ getSignature(signalTimes, signalCode, step, meterPeriod) for signalTimes in signals ]
+	correlations = [ crossCorrelate(values, signature) for signature in signatures ]
+	if len(correlations[0]) == 0:
+		print('Power log is shorter than the synchronization signal', file=sys.stderr)
+		return None
+	width = int(np.ceil(levelDuration / step))
+
+	# all signatures are the same, the first one is the candidate best confirmed by the following ones
+	positions, bestScore = None, -np.inf
+	for candidate in findPeaks(correlations[0], signalCandidates if len(signals) > 1 else 1, len(signatures[0])):
+		candidatePositions = trackSignals(correlations, signals, candidate, step, width)
+		score = sum([ correlations[i][k] for (i, k) in candidatePositions ])
+		if score > bestScore:
+			positions, bestScore = candidatePositions, score
+
+	for i in set(range(len(signals))) - set([ i for (i, _) in positions ]):
+		print('Synchronization signal ' + str(i) + ' not found in the power log', file=sys.stderr)
+
+	# refined once more with the clock rate of the first refinement, a drift stretches every signature a bit
+	fineStep = step / 10
+	fineSignatures = [ getSignature(signals[i], signalCode, fineStep, meterPeriod) for (i, _) in positions ]
+	logTimesFound = [ grid[0] + k * step for (_, k) in positions ]
+	rate = 1
+	for _ in range(2):
+		logTimesFound = [ refinePeak(logTimes, logPower, fineSignatures[n], fineStep, grid[0] + k * step, step, rate)
+		                  for n, (_, k) in enumerate(positions) ]
+		if len(positions) > 1:
+			rate = np.polyfit([ signals[i][0] for (i, _) in positions ], logTimesFound, 1)[0]
+
+	syncPoints = []
+	with open(syncFile, 'w') as file:
+		writer = csv.writer(file)
+		writer.writerow(['signal', 'measure_time', 'log_time', 'quality'])
+		for (i, k), logTime in zip(positions, logTimesFound):
+			# the other signatures match as well
+			excluded = [ (other - len(signatures[i]), other + len(signatures[i]) + 1) for (j, other) in positions if j != i ]
+			quality = peakQuality(correlations[i], k, width, excluded)
+			if quality < minSignalQuality:
+				print('Synchronization signal ' + str(i) + ' is ambiguous in the power log, quality ' + str(round(quality, 2)), file=sys.stderr)
+			syncPoints.append((signals[i][0], logTime))
+			writer.writerow([i, signals[i][0], logTime, quality])
+
+	return syncPoints
+
+# piecewise linear between the sync points, the outermost segments are extended beyond them
+def logToMeasureTime(times, syncPoints):
+	measureTimes = np.array([ point[0] for point in syncPoints ])
+	logTimes = np.array([ point[1] for point in syncPoints ])
+	if len(syncPoints) == 1:
+		return times - logTimes[0] + measureTimes[0]
+
+	result = np.interp(times, logTimes, measureTimes)
+	before, after = times < logTimes[0], times > logTimes[-1]
+	result[before] = measureTimes[0] + (times[before] - logTimes[0]) * (measureTimes[1] - measureTimes[0]) / (logTimes[1] - logTimes[0])
+	result[after] = measureTimes[-1] + (times[after] - logTimes[-1]) * (measureTimes[-1] - measureTimes[-2]) / (logTimes[-1] - logTimes[-2])
+	return result
+
+def reportClockModel(syncPoints):
+	if len(syncPoints) < 2:
+		print('Only one synchronization signal found, the clock drift of the power log is not corrected', file=sys.stderr)
+		return
+	measureTimes = np.array([ point[0] for point in syncPoints ])
+	logTimes = np.array([ point[1] for point in syncPoints ])
+	slope, intercept = np.polyfit(measureTimes, logTimes, 1)
+	# how far the drift is from constant, which only the piecewise model follows
+	deviation = np.max(np.abs(logTimes - (slope * measureTimes + intercept)))
+	print('Synchronized power log with ' + str(len(syncPoints)) + ' signals, clock drift ' + str(round((slope - 1) * 1000000, 1)) +
+	      ' ppm, deviating from linear by up to ' + str(round(deviation * 1000, 2)) + ' ms')
 
 
 def nSecToSeconds(nanoSeconds):
@@ -154,8 +219,20 @@ def getPowerValues(measurementDir, measureStartTime):
 	return powerValues
 
 
-def writePowerValues(measurementDir, powerValues):
-	powerFile = os.path.join(measurementDir, 'power')
+# windows that still met a criterion for a redo after the last repetition are not used, like missing values
+def dropInterferedWindows(measurementDir, powerValues, name):
+	interferedFile = os.path.join(measurementDir, 'interfered')
+	if not os.path.isfile(interferedFile):
+		return
+	interfered = pd.read_csv(interferedFile, names=['interfered'])['interfered']
+	for i in range(0, min(len(interfered), len(powerValues))):
+		if interfered[i]:
+			print('Dropping interfered measurement ' + name + '[' + str(i) + ']', file=sys.stderr)
+			powerValues[i] = -1
+
+
+def writePowerValues(measurementDir, powerValues, fileName='power'):
+	powerFile = os.path.join(measurementDir, fileName)
 
 	with open(powerFile, 'w') as file:
 		writer = csv.writer(file)
@@ -168,11 +245,23 @@ def associateExternalMeasurements():
 	global powerLog
 	powerLog = pd.read_csv(powerLogFile, converters={'time': decimalConverter, 'power': decimalConverter})
 
-	logStartTime = seekPattern()
-	powerLog['time'] -= logStartTime
+	signalCode = pd.read_csv(signalCodeFile, names=['signal_code'])['signal_code'].to_numpy()
+	signals = []
+	for signalFile in [ e.path for e in os.scandir(resultsDir) if e.is_file() and e.name.startswith('signal_times') ]:
+		signals.append(nSecToSeconds(pd.read_csv(signalFile, names=['signal_times'])['signal_times'].to_numpy()))
+	signals.sort(key=lambda signalTimes: signalTimes[0])
+	signalTimes = signals[0]
+
+	syncPoints = findSyncPoints(signalCode, signals)
+	if syncPoints is None:
+		sys.exit(1)
+	reportClockModel(syncPoints)
+	# from here on, the times of the power log are relative to the start of the first signal on the clock of the measured system,
+	# and each value is attributed to the middle of the period it averages
+	meterPeriod = getMeterPeriod()
+	powerLog['time'] = logToMeasureTime(powerLog['time'].astype(float).to_numpy() - meterPeriod / 2, syncPoints) - signalTimes[0]
 
-	signalTimes = pd.read_csv(signalTimesFile, names=['signal_times'])['signal_times']
-	measureStartTime = nSecToSeconds(signalTimes[0])
+	measureStartTime = signalTimes[0]
 
 	measurementTypes = [ e.name for e in os.scandir(resultsDir) if e.is_dir() ]
 	for mType in measurementTypes:
@@ -190,12 +279,22 @@ def associateExternalMeasurements():
 					print('No values found for ' + mType + ':' + mName + '[' + str(i) + ']', file=sys.stderr)
 					powerValues[i] = -1
 
+			dropInterferedWindows(measurementDir, powerValues, mType + ':' + mName)
 			writePowerValues(measurementDir, powerValues)
 
 
 def toJoule(point1MicroJoule):
 	return point1MicroJoule / 10000000
 
+def warnAboutContamination(measurementDir, name):
+	contaminatedFile = os.path.join(measurementDir, 'contaminated_counters')
+	if not os.path.isfile(contaminatedFile):
+		return
+	with open(contaminatedFile) as file:
+		counters = file.read().split()
+	if counters:
+		print('Counters of ' + name + ' include housekeeping CPUs: ' + ', '.join(counters), file=sys.stderr)
+
 def evaluateInternalMeasurements():
 	measurementTypes = [ e.name for e in os.scandir(resultsDir) if e.is_dir() ]
 	for mType in measurementTypes:
@@ -203,23 +302,360 @@ def evaluateInternalMeasurements():
 		measurementNames = [ e.name for e in os.scandir(typeDir) if e.is_dir() ]
 		for mName in measurementNames:
 			measurementDir = os.path.join(typeDir, mName)
+			warnAboutContamination(measurementDir, mType + ':' + mName)
 
 			energyFile = os.path.join(measurementDir, 'energy_consumption')
 			energyValues = pd.read_csv(energyFile, names=['energy'])['energy']
 
-			powerValues = toJoule(energyValues) / duration
+			# if the energy was sampled over a different interval than the measurement itself (ARM), it is published as well
+			energyDurationFile = os.path.join(measurementDir, 'energy_duration')
+			if os.path.isfile(energyDurationFile):
+				energyDurations = pd.read_csv(energyDurationFile, names=['duration'])['duration']
+				powerValues = toJoule(energyValues) / nSecToSeconds(energyDurations)
+			else:
+				powerValues = toJoule(energyValues) / getDuration(measurementDir)
 
 			for i in range(0, len(powerValues)):
 				powerValues[i] = round(Decimal(powerValues[i]), 5)
 
+			dropInterferedWindows(measurementDir, powerValues, mType + ':' + mName)
 			writePowerValues(measurementDir, powerValues)
 
 
+calibrationDir = os.path.join(resultsDir, 'calibration')
+calibrationModelFile = os.path.join(calibrationDir, 'model')
+
+# measurements with a window length differing from the global one have their own duration file
+def getDuration(measurementDir):
+	durationFile = os.path.join(measurementDir, 'duration')
+	if os.path.isfile(durationFile):
+		return pd.read_csv(durationFile, names=['duration'])['duration'][0] / 1000
+	return duration
+
+def getMedianPower(measurementDir):
+	powerValues = pd.read_csv(os.path.join(measurementDir, 'power'), names=['power'])['power']
+	return powerValues[powerValues >= 0].median()
+
+def getPollingCpus(measurementDir):
+	pollingCpusFile = os.path.join(measurementDir, 'polling_cpus')
+	if not os.path.isfile(pollingCpusFile):
+		return 0
+	return pd.read_csv(pollingCpusFile, names=['polling_cpus'])['polling_cpus'][0]
+
+# every window contains a fixed amount of energy for synchronization, the leader's NMI and reading the counters,
+# and every polling CPU adds its power on top of what it would consume sleeping
+def calculateCalibrationModel():
+	sleepDir = os.path.join(calibrationDir, 'sleep')
+	sleepHalfDir = os.path.join(calibrationDir, 'sleep_half')
+	pollDir = os.path.join(calibrationDir, 'poll')
+
+	sleepEnergy = getMedianPower(sleepDir) * getDuration(sleepDir)
+	sleepHalfEnergy = getMedianPower(sleepHalfDir) * getDuration(sleepHalfDir)
+	sleepPower = (sleepEnergy - sleepHalfEnergy) / (getDuration(sleepDir) - getDuration(sleepHalfDir))
+	windowEnergy = sleepEnergy - sleepPower * getDuration(sleepDir)
+
+	pollCpuPower = (getMedianPower(pollDir) - getMedianPower(sleepDir)) / getPollingCpus(pollDir)
+
+	return windowEnergy, pollCpuPower
+
+def writeCalibrationModel(windowEnergy, pollCpuPower):
+	with open(calibrationModelFile, 'w') as file:
+		writer = csv.writer(file)
+		writer.writerow(['window_energy', windowEnergy])
+		writer.writerow(['poll_cpu_power', pollCpuPower])
+
+def correctBaseline():
+	if not os.path.isdir(calibrationDir):
+		return
+	try:
+		windowEnergy, pollCpuPower = calculateCalibrationModel()
+	except (FileNotFoundError, ZeroDivisionError):
+		print('Calibration incomplete, no baseline corrected power values are generated', file=sys.stderr)
+		return
+	writeCalibrationModel(windowEnergy, pollCpuPower)
+
+	measurementTypes = [ e.name for e in os.scandir(resultsDir) if e.is_dir() and e.name != 'calibration' ]
+	for mType in measurementTypes:
+		typeDir = os.path.join(resultsDir, mType)
+		measurementNames = [ e.name for e in os.scandir(typeDir) if e.is_dir() ]
+		for mName in measurementNames:
+			measurementDir = os.path.join(typeDir, mName)
+			if not os.path.isfile(os.path.join(measurementDir, 'power')):
+				continue
+
+			baseline = windowEnergy / getDuration(measurementDir) + getPollingCpus(measurementDir) * pollCpuPower
+			powerValues = pd.read_csv(os.path.join(measurementDir, 'power'), names=['power'])['power']
+			correctedValues = [ round(Decimal(p - baseline), 5) if p >= 0 else -1 for p in powerValues ]
+
+			writePowerValues(measurementDir, correctedValues, 'power_corrected')
+
+
+scheduleFile = os.path.join(resultsDir, 'schedule')
+driftModelFile = os.path.join(resultsDir, 'drift')
+driftDegree = 2
+
+# with interleaved configurations, slow drift (e.g. temperature) is no longer correlated with the configuration
+# a polynomial in time is fitted jointly with one constant per configuration and then removed
+def removeDrift():
+	if not os.path.isfile(scheduleFile):
+		return
+
+	measurementDirs = []
+	for mType in [ e.name for e in os.scandir(resultsDir) if e.is_dir() ]:
+		typeDir = os.path.join(resultsDir, mType)
+		for mName in [ e.name for e in os.scandir(typeDir) if e.is_dir() ]:
+			measurementDir = os.path.join(typeDir, mName)
+			if os.path.isfile(os.path.join(measurementDir, 'power')):
+				measurementDirs.append(measurementDir)
+
+	times, powers, configs = [], [], []
+	for config, measurementDir in enumerate(measurementDirs):
+		startTimes = pd.read_csv(os.path.join(measurementDir, 'start_time'), names=['start_time'])['start_time']
+		powerValues = pd.read_csv(os.path.join(measurementDir, 'power'), names=['power'])['power']
+		for time, power in zip(startTimes, powerValues):
+			if power >= 0:
+				times.append(nSecToSeconds(time))
+				powers.append(power)
+				configs.append(config)
+
+	if len(powers) <= len(measurementDirs) + driftDegree:
+		print('Not enough measurements to estimate the drift', file=sys.stderr)
+		return
+
+	times = np.array(times)
+	origin, span = times.mean(), max(times.max() - times.min(), 1e-9)
+	normalizedTimes = (times - origin) / span
+
+	design = np.zeros((len(powers), len(measurementDirs) + driftDegree))
+	design[np.arange(len(powers)), configs] = 1
+	for degree in range(1, driftDegree + 1):
+		design[:, len(measurementDirs) + degree - 1] = normalizedTimes ** degree
+	solution = np.linalg.lstsq(design, np.array(powers), rcond=None)[0]
+	coefficients = solution[len(measurementDirs):]
+
+	def drift(time):
+		normalizedTime = (time - origin) / span
+		return sum(coefficients[degree - 1] * normalizedTime ** degree for degree in range(1, driftDegree + 1))
+	# keep the overall level, only the variation over time is removed
+	offset = np.mean([ drift(time) for time in times ])
+
+	with open(driftModelFile, 'w') as file:
+		writer = csv.writer(file)
+		writer.writerow(['origin', origin])
+		writer.writerow(['span', span])
+		writer.writerow(['offset', offset])
+		for degree in range(1, driftDegree + 1):
+			writer.writerow(['coefficient' + str(degree), coefficients[degree - 1]])
+	drifts = [ drift(time) - offset for time in times ]
+	print('Removing drift between ' + str(round(min(drifts), 5)) + ' W and ' + str(round(max(drifts), 5)) + ' W')
+
+	for measurementDir in measurementDirs:
+		startTimes = pd.read_csv(os.path.join(measurementDir, 'start_time'), names=['start_time'])['start_time']
+		powerValues = pd.read_csv(os.path.join(measurementDir, 'power'), names=['power'])['power']
+		detrendedValues = [ round(Decimal(power - drift(nSecToSeconds(time)) + offset), 5) if power >= 0 else -1
+				    for time, power in zip(startTimes, powerValues) ]
+		writePowerValues(measurementDir, detrendedValues, 'power_detrended')
+
+
+unusedHintsFile = os.path.join(resultsDir, 'unused_hints')
+hintsDir = os.path.join(resultsDir, 'hints')
+
+# MWAIT hints supported by the CPU that the idle driver does not use, next to the power of the idle states it does use
+def reportUnusedHints():
+	if not os.path.isfile(unusedHintsFile):
+		return
+	with open(unusedHintsFile) as file:
+		hints = file.read().split()
+	print('MWAIT hints not used by the idle driver:')
+	for hint in hints:
+		hintDir = os.path.join(hintsDir, hint)
+		if os.path.isfile(os.path.join(hintDir, 'power')):
+			print('    ' + hint + ': ' + str(round(getMedianPower(hintDir), 5)) + ' W')
+		else:
+			print('    ' + hint + ': no power values')
+	statesDir = os.path.join(resultsDir, 'states')
+	if os.path.isdir(statesDir):
+		for state in sorted([ e.name for e in os.scandir(statesDir) if e.is_dir() ]):
+			stateDir = os.path.join(statesDir, state)
+			if os.path.isfile(os.path.join(stateDir, 'power')):
+				print('    compared to ' + state + ': ' + str(round(getMedianPower(stateDir), 5)) + ' W')
+
+
+refillDir = os.path.join(resultsDir, 'refill')
+refillCostFile = os.path.join(outputDir, 'refill_cost.csv')
+
+# the penalty of an idle state on warm data is the time to touch the working set after the wakeup beyond the time while it is cached,
+# medians over all CPUs and windows in nanoseconds
+def reportRefillCost():
+	if not os.path.isdir(refillDir):
+		return
+	rows = []
+	for measurementDir in [ e.path for e in os.scandir(refillDir) if e.is_dir() ]:
+		workingSet = pd.read_csv(os.path.join(measurementDir, 'working_set'), names=['working_set'])['working_set'][0]
+		warmTimes, refillTimes = [], []
+		for cpuDir in [ e.path for e in os.scandir(measurementDir) if e.is_dir() and re.fullmatch(r'cpu\d+', e.name) ]:
+			warmTimes += list(pd.read_csv(os.path.join(cpuDir, 'warm_time'), names=['warm_time'])['warm_time'])
+			refillTimes += list(pd.read_csv(os.path.join(cpuDir, 'refill_time'), names=['refill_time'])['refill_time'])
+		state = os.path.basename(measurementDir).removesuffix('_' + str(workingSet) + 'K')
+		rows.append([ state, workingSet, int(np.median(warmTimes)), int(np.median(refillTimes)),
+		              int(np.median(np.array(refillTimes) - np.array(warmTimes))) ])
+	rows.sort(key=lambda row: (row[1], row[0]))
+
+	with open(refillCostFile, 'w') as file:
+		writer = csv.writer(file)
+		writer.writerow(['state', 'working_set', 'warm_time', 'refill_time', 'penalty'])
+		writer.writerows(rows)
+	print('Cache and TLB refill penalty after the wakeup:')
+	for state, workingSet, _, _, penalty in rows:
+		print('    ' + state + ' with ' + str(workingSet) + ' KiB: ' + str(round(penalty / 1000, 1)) + ' us')
+
+
+wakeupsDir = os.path.join(resultsDir, 'wakeups')
+wakeupEnergyFile = os.path.join(outputDir, 'wakeup_energy.csv')
+
+def readParameter(measurementDir, name):
+	with open(os.path.join(measurementDir, name)) as file:
+		return file.read().strip()
+
+# the energy per wakeup is the power beyond the one of the same state without periodic wakeups, divided by the wakeup rate
+# every CPU also wakes up once at the end of each window, in both measurements
+def reportWakeupEnergy():
+	if not os.path.isdir(wakeupsDir):
+		return
+	rows = []
+	for measurementDir in [ e.path for e in os.scandir(wakeupsDir) if e.is_dir() ]:
+		rate = int(readParameter(measurementDir, 'wakeup_rate'))
+		alignment = readParameter(measurementDir, 'wakeup_alignment')
+		state = os.path.basename(measurementDir).removesuffix('_' + alignment + '_' + str(rate))
+		baselineDirs = [ os.path.join(resultsDir, mType, state) for mType in ['states', 'hints'] ]
+		baselineDirs = [ d for d in baselineDirs if os.path.isfile(os.path.join(d, 'power')) ]
+		if not os.path.isfile(os.path.join(measurementDir, 'power')) or not baselineDirs:
+			print('No power values for the wakeups of ' + state + ' at ' + str(rate) + ' per second', file=sys.stderr)
+			continue
+
+		wakeups = None
+		for cpuDir in [ e.path for e in os.scandir(measurementDir) if e.is_dir() and re.fullmatch(r'cpu\d+', e.name) ]:
+			cpuWakeups = pd.read_csv(os.path.join(cpuDir, 'wakeups'), names=['wakeups'])['wakeups'].to_numpy() - 1
+			wakeups = cpuWakeups if wakeups is None else wakeups + cpuWakeups
+		wakeupRate = np.median(wakeups) / getDuration(measurementDir)
+		power = getMedianPower(measurementDir)
+		baselinePower = getMedianPower(baselineDirs[0])
+		energy = (power - baselinePower) / wakeupRate * 1000000 if wakeupRate > 0 else float('nan')
+		rows.append([ state, alignment, rate, round(wakeupRate), round(power, 5), round(baselinePower, 5), round(energy, 3) ])
+	rows.sort(key=lambda row: (row[0], row[2], row[1]))
+
+	with open(wakeupEnergyFile, 'w') as file:
+		writer = csv.writer(file)
+		writer.writerow(['state', 'alignment', 'rate', 'wakeups_per_second', 'power', 'baseline_power', 'energy_per_wakeup'])
+		writer.writerows(rows)
+	print('Energy per wakeup:')
+	for state, alignment, rate, _, _, _, energy in rows:
+		print('    ' + state + ' at ' + str(rate) + '/s ' + alignment + ': ' + str(energy) + ' uJ')
+
+
+pkgCstDir = os.path.join(resultsDir, 'pkg_cst')
+pkgCstSweepFile = os.path.join(outputDir, 'pkg_cst_sweep.csv')
+pkgCstates = ['c2', 'c3', 'c6', 'c7']
+
+# power and Package C-state residencies of every idle state with each Package C-state limit and auto-demotion setting,
+# the lowest power per state is the setting to put into the firmware
+def reportPkgCstSweep():
+	if not os.path.isdir(pkgCstDir):
+		return
+	rows = []
+	for measurementDir in [ e.path for e in os.scandir(pkgCstDir) if e.is_dir() ]:
+		if not os.path.isfile(os.path.join(measurementDir, 'power')):
+			continue
+		name = os.path.basename(measurementDir)
+		limit = readParameter(measurementDir, 'pkg_cstate_limit') if os.path.isfile(os.path.join(measurementDir, 'pkg_cstate_limit')) else ''
+		demotion = readParameter(measurementDir, 'auto_demotion') if os.path.isfile(os.path.join(measurementDir, 'auto_demotion')) else ''
+		state = re.sub(r'(_limit\d+)?(_demotion\d+)?$', '', name)
+
+		residencies = []
+		totalTsc = pd.read_csv(os.path.join(measurementDir, 'total_tsc'), names=['tsc'])['tsc']
+		for cstate in pkgCstates:
+			cstateFile = os.path.join(measurementDir, cstate)
+			residencies.append(round((pd.read_csv(cstateFile, names=[cstate])[cstate] / totalTsc).median(), 4) if os.path.isfile(cstateFile) else '')
+		rows.append([ state, limit, demotion, round(getMedianPower(measurementDir), 5) ] + residencies)
+	rows.sort(key=lambda row: (row[0], row[3]))
+
+	with open(pkgCstSweepFile, 'w') as file:
+		writer = csv.writer(file)
+		writer.writerow(['state', 'pkg_cstate_limit', 'auto_demotion', 'power'] + [ 'pkg_' + cstate for cstate in pkgCstates ])
+		writer.writerows(rows)
+	print('Lowest power per idle state over the Package C-state settings:')
+	for state in sorted(set(row[0] for row in rows)):
+		best = [ row for row in rows if row[0] == state ][0]
+		print('    ' + state + ': ' + str(best[3]) + ' W with limit ' + (best[1] or 'unchanged') + ', auto-demotion ' + (best[2] or 'unchanged'))
+
+
+coreTypesFile = os.path.join(outputDir, 'core_types.csv')
+coreCstates = ['c3', 'c6', 'c7']
+
+def readCpuColumn(cpuDir, name):
+	return pd.read_csv(os.path.join(cpuDir, name), names=[name])[name]
+
+# wakeup times and core C-state residencies of the CPUs of each core type on hybrid CPUs
+# in 'states_performance' and 'states_efficiency', only the CPUs of one type sleep and the others poll,
+# so the power saved against all CPUs polling, divided by their number, is the saving of one CPU (hardware thread) of that type
+def reportCoreTypes():
+	pollDir = os.path.join(calibrationDir, 'poll')
+	pollPower = getMedianPower(pollDir) if os.path.isfile(os.path.join(pollDir, 'power')) else None
+	rows = []
+	for mType in ['states', 'states_performance', 'states_efficiency']:
+		typeDir = os.path.join(resultsDir, mType)
+		if not os.path.isdir(typeDir):
+			continue
+		for measurementDir in [ e.path for e in os.scandir(typeDir) if e.is_dir() ]:
+			cpuDirs = [ e.path for e in os.scandir(measurementDir) if e.is_dir() and re.fullmatch(r'cpu\d+', e.name) ]
+			cpuDirs = [ d for d in cpuDirs if os.path.isfile(os.path.join(d, 'core_type')) ]
+			if not cpuDirs:
+				continue
+			totalTsc = pd.read_csv(os.path.join(measurementDir, 'total_tsc'), names=['tsc'])['tsc'] if os.path.isfile(os.path.join(measurementDir, 'total_tsc')) else None
+			for coreType in ['performance', 'efficiency']:
+				if mType != 'states' and mType != 'states_' + coreType:
+					continue
+				typeCpuDirs = [ d for d in cpuDirs if readParameter(d, 'core_type') == coreType ]
+				if not typeCpuDirs:
+					continue
+				wakeupTimes = pd.concat([ readCpuColumn(d, 'wakeup_time') for d in typeCpuDirs ])
+				saving = ''
+				if mType != 'states' and pollPower is not None and os.path.isfile(os.path.join(measurementDir, 'power')):
+					saving = round((pollPower - getMedianPower(measurementDir)) / len(typeCpuDirs), 5)
+				residencies = []
+				for cstate in coreCstates:
+					if totalTsc is None or not os.path.isfile(os.path.join(typeCpuDirs[0], cstate)):
+						residencies.append('')
+						continue
+					residencies.append(round(pd.concat([ readCpuColumn(d, cstate) / totalTsc for d in typeCpuDirs ]).median(), 4))
+				rows.append([ mType, os.path.basename(measurementDir), coreType, len(typeCpuDirs),
+				              round(wakeupTimes[wakeupTimes >= 0].median() / 1000, 3), saving ] + residencies)
+	if not rows:
+		return
+	rows.sort(key=lambda row: (row[1], row[2], row[0]))
+
+	with open(coreTypesFile, 'w') as file:
+		writer = csv.writer(file)
+		writer.writerow(['measurement', 'state', 'core_type', 'cpus', 'wakeup_time', 'saving_per_cpu'] + [ 'core_' + cstate for cstate in coreCstates ])
+		writer.writerows(rows)
+	print('Power saved per CPU by each idle state, by core type:')
+	for row in rows:
+		if row[5] != '':
+			print('    ' + row[1] + ' on the ' + row[2] + ' cores: ' + str(row[5]) + ' W, wakeup after ' + str(row[4]) + ' us')
+
+
 def main():
 	if os.path.isfile(signalTimesFile):
 		associateExternalMeasurements()
 	else:
 		evaluateInternalMeasurements()
+	correctBaseline()
+	removeDrift()
+	reportUnusedHints()
+	reportRefillCost()
+	reportWakeupEnergy()
+	reportPkgCstSweep()
+	reportCoreTypes()
 
 
 main()
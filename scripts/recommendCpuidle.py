@@ -0,0 +1,209 @@
+#!/usr/bin/env python3
+
+"""
+Recommends the exit latency and target residency of every cpuidle state for the measured machine.
+
+The latency is a high percentile of the measured wakeup times, less the wakeup time of polling, which is the harness alone.
+The target residency is the break-even time against every shallower state, from the measured power and the energy of
+entering and leaving the state. That energy is the slope of the power over the wakeup rate (mwait_deploy/measure.sh -F),
+or else follows from measuring the state with two window lengths (mwait_deploy/measure.sh -L). Transition energies within
+the noise of the power measurements are flagged and do not enter the target residency.
+The recommendation is written to output/cpuidle_recommendation.csv and as a diff against the current values to output/cpuidle.diff.
+"""
+
+import numpy as np
+import pandas as pd
+import os, sys
+import re
+import csv
+import difflib
+
+scriptDir = os.path.dirname(__file__)
+outputDir = os.path.normpath(os.path.join(scriptDir, '..', 'output'))
+resultsDir = os.path.join(outputDir, 'results')
+cpuidleStatesFile = os.path.join(resultsDir, 'cpuidle_states')
+statesDir = os.path.join(resultsDir, 'states')
+statesHalfDir = os.path.join(resultsDir, 'states_half')
+wakeupsDir = os.path.join(resultsDir, 'wakeups')
+recommendationFile = os.path.join(outputDir, 'cpuidle_recommendation.csv')
+diffFile = os.path.join(outputDir, 'cpuidle.diff')
+
+# percentile of the wakeup times used as exit latency, the governor relies on it as an upper bound
+latencyPercentile = 99
+# a transition energy is significant once it exceeds this many standard errors
+significanceLevel = 2
+
+
+def getDuration(measurementDir):
+	durationFile = os.path.join(measurementDir, 'duration')
+	if not os.path.isfile(durationFile):
+		durationFile = os.path.join(resultsDir, 'duration')
+	return pd.read_csv(durationFile, names=['duration'])['duration'][0] / 1000
+
+def getPowerValues(measurementDir):
+	return pd.read_csv(os.path.join(measurementDir, 'power'), names=['power'])['power'].to_numpy()
+
+def getMedianPower(measurementDir):
+	powerValues = getPowerValues(measurementDir)
+	return np.median(powerValues[powerValues >= 0])
+
+# standard error of the median of normally distributed values
+def getMedianError(measurementDir):
+	powerValues = getPowerValues(measurementDir)
+	powerValues = powerValues[powerValues >= 0]
+	return 1.2533 * np.std(powerValues, ddof=1) / np.sqrt(len(powerValues)) if len(powerValues) > 1 else float('inf')
+
+def getCpuDirs(measurementDir):
+	return [ e.path for e in os.scandir(measurementDir) if e.is_dir() and re.fullmatch(r'cpu\d+', e.name) ]
+
+# wakeup times of all measured CPUs in microseconds
+def getWakeupTimes(measurementDir):
+	wakeupTimes = []
+	for cpuDir in getCpuDirs(measurementDir):
+		values = pd.read_csv(os.path.join(cpuDir, 'wakeup_time'), names=['wakeup_time'])['wakeup_time']
+		wakeupTimes += list(values[values >= 0] / 1000)
+	return np.array(wakeupTimes)
+
+# wakeups per second of all CPUs in every window, not counting the one at the end of the window
+def getWakeupRates(measurementDir):
+	wakeups = None
+	for cpuDir in getCpuDirs(measurementDir):
+		cpuWakeups = pd.read_csv(os.path.join(cpuDir, 'wakeups'), names=['wakeups'])['wakeups'].to_numpy() - 1
+		wakeups = cpuWakeups if wakeups is None else wakeups + cpuWakeups
+	return wakeups / getDuration(measurementDir)
+
+# energy of one wakeup of every CPU and its standard error, from a line fitted to the power over the wakeup rate of
+# every window without and with synchronized periodic wakeups, which resemble all CPUs leaving the state at the window end
+def getSweepTransitionEnergy(name):
+	if not os.path.isdir(wakeupsDir):
+		return None
+	measurementDirs = [ os.path.join(statesDir, name) ]
+	measurementDirs += [ e.path for e in os.scandir(wakeupsDir) if e.is_dir() and re.fullmatch(re.escape(name) + r'_synchronized_\d+', e.name) ]
+	measurementDirs = [ d for d in measurementDirs if os.path.isfile(os.path.join(d, 'power')) ]
+	if len(measurementDirs) < 2:
+		return None
+
+	wakeupRates = []
+	powerValues = []
+	for measurementDir in measurementDirs:
+		rates = getWakeupRates(measurementDir)
+		power = getPowerValues(measurementDir)
+		valid = power >= 0
+		wakeupRates += list(rates[valid])
+		powerValues += list(power[valid])
+	if len(powerValues) < 3 or np.ptp(wakeupRates) == 0:
+		return None
+
+	(energyPerWakeup, _), covariance = np.polyfit(wakeupRates, powerValues, 1, cov=True)
+	cpuCount = len(getCpuDirs(measurementDirs[0]))
+	return energyPerWakeup * cpuCount, np.sqrt(covariance[0][0]) * cpuCount
+
+# energy of entering and leaving the state in one window and its standard error, from the difference of the windows
+# with full and half length, which only is significant if it exceeds the noise of both
+def getWindowTransitionEnergy(fullDir, halfDir):
+	fullDuration = getDuration(fullDir)
+	halfDuration = getDuration(halfDir)
+	scale = fullDuration * halfDuration / (fullDuration - halfDuration)
+	transitionEnergy = scale * (getMedianPower(halfDir) - getMedianPower(fullDir))
+	return transitionEnergy, scale * np.sqrt(getMedianError(fullDir) ** 2 + getMedianError(halfDir) ** 2)
+
+# energy of one window, split into the power while in the state and the energy of entering and leaving it,
+# plus whether that energy is significant and where it comes from
+def getEnergyModel(name):
+	fullDir = os.path.join(statesDir, name)
+	halfDir = os.path.join(statesHalfDir, name)
+	fullEnergy = getMedianPower(fullDir) * getDuration(fullDir)
+
+	transitionEnergy = getSweepTransitionEnergy(name)
+	source = 'wakeups'
+	if transitionEnergy is None and os.path.isfile(os.path.join(halfDir, 'power')):
+		transitionEnergy = getWindowTransitionEnergy(fullDir, halfDir)
+		source = 'windows'
+	if transitionEnergy is None:
+		return getMedianPower(fullDir), None, False, ''
+
+	transitionEnergy, error = transitionEnergy
+	significant = transitionEnergy > significanceLevel * error
+	if not significant:
+		print('The transition energy of ' + name + ' (' + str(transitionEnergy) + ' J from ' + source + ') is within the noise of ' +
+		      str(significanceLevel * error) + ' J', file=sys.stderr)
+	# transitions cannot save energy, negative values are noise
+	transitionEnergy = max(transitionEnergy, 0)
+	return (fullEnergy - transitionEnergy) / getDuration(fullDir), transitionEnergy, significant, source
+
+
+def recommend(states):
+	pollLatency = 0
+	if 'POLL' in states['name'].values and os.path.isdir(os.path.join(statesDir, 'POLL')):
+		pollLatency = np.median(getWakeupTimes(os.path.join(statesDir, 'POLL')))
+
+	recommendations = []
+	withoutTransitionEnergy = False
+	for _, state in states.iterrows():
+		measurementDir = os.path.join(statesDir, state['name'])
+		if state['name'] == 'POLL' or not os.path.isfile(os.path.join(measurementDir, 'power')):
+			continue
+		wakeupTimes = getWakeupTimes(measurementDir)
+		latency = max(np.percentile(wakeupTimes, latencyPercentile) - pollLatency, 0) if len(wakeupTimes) else state['latency']
+		power, transitionEnergy, significant, source = getEnergyModel(state['name'])
+		withoutTransitionEnergy |= transitionEnergy is None
+
+		# deeper states only pay off once their lower power has made up for the additional transition energy
+		residency = latency
+		for shallower in recommendations:
+			if not significant or not shallower['significant']:
+				continue
+			if power >= shallower['power']:
+				print(state['name'] + ' consumes no less power than ' + shallower['name'] + ', it never pays off', file=sys.stderr)
+				continue
+			breakEven = (transitionEnergy - shallower['transition_energy']) / (shallower['power'] - power) * 1000000
+			residency = max(residency, breakEven)
+
+		recommendations.append({ 'state': state['state'], 'name': state['name'], 'power': power, 'transition_energy': transitionEnergy,
+		                         'significant': significant, 'source': source,
+		                         'latency': int(np.ceil(latency)), 'target_residency': int(np.ceil(residency)),
+		                         'current_latency': state['latency'], 'current_target_residency': state['target_residency'] })
+
+	if withoutTransitionEnergy:
+		print('Idle states were measured neither with wakeups (measure.sh -F) nor with half the window length (measure.sh -L), ' +
+		      'target residencies only follow the latency', file=sys.stderr)
+	return recommendations
+
+def writeRecommendation(recommendations):
+	with open(recommendationFile, 'w') as file:
+		writer = csv.writer(file)
+		writer.writerow(['state', 'name', 'power', 'transition_energy', 'transition_energy_source', 'transition_energy_significant',
+		                 'latency', 'target_residency'])
+		for r in recommendations:
+			writer.writerow([ r['state'], r['name'], round(r['power'], 5),
+			                  '' if r['transition_energy'] is None else round(r['transition_energy'], 9), r['source'], r['significant'],
+			                  r['latency'], r['target_residency'] ])
+
+def writeDiff(recommendations):
+	current = []
+	recommended = []
+	for r in recommendations:
+		for value in ['latency', 'target_residency']:
+			current.append(r['state'] + '/' + value + ': ' + str(r['current_' + value]) + '  # ' + r['name'] + '\n')
+			recommended.append(r['state'] + '/' + value + ': ' + str(r[value]) + '  # ' + r['name'] + '\n')
+	diff = ''.join(difflib.unified_diff(current, recommended, 'current', 'recommended', n=0))
+	with open(diffFile, 'w') as file:
+		file.write(diff)
+	if diff:
+		print(diff, end='')
+	else:
+		print('The current cpuidle values match the measurements')
+
+
+def main():
+	if not os.path.isfile(cpuidleStatesFile) or not os.path.isdir(statesDir):
+		print('No cpuidle states were measured', file=sys.stderr)
+		exit(1)
+	states = pd.read_csv(cpuidleStatesFile, dtype={'name': str, 'state': str})
+	states = states.iloc[states['state'].map(lambda state: int(state.removeprefix('state'))).argsort()]
+	recommendations = recommend(states)
+	writeRecommendation(recommendations)
+	writeDiff(recommendations)
+	exit(0)
+
+main()
@@ -0,0 +1,265 @@
+#!/usr/bin/env python3
+
+"""
+Simulates idle governor policies on recorded idle traces, using the idle states as measured on this machine.
+
+The model of every state is its power, the energy of entering and leaving it, its exit latency and target residency,
+as determined by scripts/recommendCpuidle.py, plus the distribution of its measured wakeup times.
+The traces are the ones written by scripts/convertIdleTrace.py. For every policy and parameter combination, the energy
+spent idling, the idle periods in too deep or too shallow states, the wakeups later than the latency limit and the
+percentiles of the wakeup latency are reported and written to output/governor_simulation.csv.
+
+All policies work on whole arrays of idle periods, so that parameters can be swept over traces with millions of them.
+"""
+
+import numpy as np
+import pandas as pd
+import os, sys
+import re
+import getopt
+import itertools
+import importlib.util
+
+scriptDir = os.path.dirname(__file__)
+outputDir = os.path.normpath(os.path.join(scriptDir, '..', 'output'))
+resultsDir = os.path.join(outputDir, 'results')
+cpuidleStatesFile = os.path.join(resultsDir, 'cpuidle_states')
+statesDir = os.path.join(resultsDir, 'states')
+recommendationFile = os.path.join(outputDir, 'cpuidle_recommendation.csv')
+traceFile = os.path.join(outputDir, 'idle_trace.bin')
+simulationFile = os.path.join(outputDir, 'governor_simulation.csv')
+
+# the layout of scripts/convertIdleTrace.py
+headerFormat = np.dtype([('magic', 'S8'), ('version', '<u4'), ('record_size', '<u4'), ('record_count', '<u8')])
+recordFormat = np.dtype([('cpu', '<u4'), ('state', '<u4'), ('idle', '<u8'), ('busy', '<u8')])
+
+defaultParams = {
+	'latency_limit': np.inf,	# microseconds, states with a higher exit latency are not used (like a PM QoS limit)
+	'window': 8,			# menu: number of recent idle periods the typical interval is taken from
+	'outliers': 2,			# menu: at most this many of the longest idle periods are discarded as outliers
+	'decay': 0.9,			# teo: weight of the history per idle period
+	'threshold': 0.5,		# teo: share of recent idle periods that has to be long enough for a state
+}
+
+def help():
+	print('Syntax: simulateGovernor.py [-p <policy>,...] [-P <file>] [-s <parameter>=<value>,...]... [<trace>...]')
+	print('    <trace>: Idle traces written by scripts/convertIdleTrace.py, output/idle_trace.bin by default')
+	print('    -p: Policies to simulate, of ' + ', '.join(policies) + ' (default all)')
+	print('    -P: Python file with a custom policy, a function selectStates(idle, model, params) returning the state of every idle period')
+	print('    -s: Simulate every value of the parameter, e.g. -s decay=0.8,0.9,0.95; parameters: ' +
+	      ', '.join(name + ' (' + str(value) + ')' for name, value in defaultParams.items()))
+
+
+class Model:
+	def __init__(self, states):
+		self.index = np.array([ state['index'] for state in states ])
+		self.names = [ state['name'] for state in states ]
+		self.power = np.array([ state['power'] for state in states ])
+		self.transitionEnergy = np.array([ state['transition_energy'] for state in states ])
+		self.latency = np.array([ state['latency'] for state in states ], dtype=float)
+		# a deeper state is never worth it for shorter idle periods than a shallower one
+		self.residency = np.maximum.accumulate(np.array([ state['target_residency'] for state in states ], dtype=float))
+		self.wakeupTimes = [ state['wakeup_times'] for state in states ]
+
+	def allowed(self, params):
+		return self.latency <= params['latency_limit']
+
+	# energy of every state for every idle period, in Joule
+	def energy(self, idle):
+		return self.power[np.newaxis, :] * idle[:, np.newaxis] / 1000000 + self.transitionEnergy[np.newaxis, :]
+
+	# the deepest allowed state whose target residency does not exceed the predicted idle time
+	def deepestFor(self, predicted, params):
+		allowed = np.flatnonzero(self.allowed(params))
+		position = np.searchsorted(self.residency[allowed], predicted, side='right') - 1
+		return allowed[np.maximum(position, 0)]
+
+
+def getCpuCount(measurementDir):
+	return len([ e for e in os.scandir(measurementDir) if e.is_dir() and re.fullmatch(r'cpu\d+', e.name) ])
+
+def getMedianPower(measurementDir):
+	powerValues = pd.read_csv(os.path.join(measurementDir, 'power'), names=['power'])['power']
+	return powerValues[powerValues >= 0].median()
+
+def getWakeupTimes(measurementDir):
+	wakeupTimes = []
+	for cpuDir in [ e.path for e in os.scandir(measurementDir) if e.is_dir() and re.fullmatch(r'cpu\d+', e.name) ]:
+		values = pd.read_csv(os.path.join(cpuDir, 'wakeup_time'), names=['wakeup_time'])['wakeup_time']
+		wakeupTimes += list(values[values >= 0] / 1000)
+	return np.array(wakeupTimes)
+
+# The measured power is the one of the package with all measured CPUs in the state, so it is divided among them
+# The power of the CPUs while busy is the same for every policy and left out
+def loadModel():
+	if not os.path.isfile(recommendationFile):
+		print('No idle state model in ' + recommendationFile + ', run scripts/recommendCpuidle.py first', file=sys.stderr)
+		exit(1)
+	recommendation = pd.read_csv(recommendationFile, dtype={'state': str, 'name': str})
+	cpuidleStates = pd.read_csv(cpuidleStatesFile, dtype={'state': str, 'name': str})
+
+	states = []
+	pollLatency = 0
+	pollDir = os.path.join(statesDir, 'POLL')
+	if 'POLL' in cpuidleStates['name'].values and os.path.isfile(os.path.join(pollDir, 'power')):
+		pollLatency = np.median(getWakeupTimes(pollDir))
+		states.append({ 'index': int(cpuidleStates[cpuidleStates['name'] == 'POLL']['state'].iloc[0].removeprefix('state')), 'name': 'POLL',
+		                'power': getMedianPower(pollDir) / getCpuCount(pollDir), 'transition_energy': 0, 'latency': 0, 'target_residency': 0,
+		                'wakeup_times': np.zeros(1) })
+
+	for _, state in recommendation.iterrows():
+		measurementDir = os.path.join(statesDir, state['name'])
+		cpuCount = getCpuCount(measurementDir)
+		wakeupTimes = np.maximum(getWakeupTimes(measurementDir) - pollLatency, 0)
+		states.append({ 'index': int(state['state'].removeprefix('state')), 'name': state['name'],
+		                'power': state['power'] / cpuCount,
+		                'transition_energy': 0 if pd.isna(state['transition_energy']) else state['transition_energy'] / cpuCount,
+		                'latency': state['latency'], 'target_residency': state['target_residency'],
+		                'wakeup_times': wakeupTimes if len(wakeupTimes) else np.full(1, state['latency']) })
+
+	states.sort(key=lambda state: state['index'])
+	return Model(states)
+
+def readTrace(path):
+	header = np.fromfile(path, dtype=headerFormat, count=1)
+	if len(header) != 1 or header['magic'][0] != b'MWREPLAY' or header['record_size'][0] != recordFormat.itemsize:
+		print(path + ' is not an idle trace', file=sys.stderr)
+		exit(1)
+	return np.fromfile(path, dtype=recordFormat, count=int(header['record_count'][0]), offset=headerFormat.itemsize)
+
+
+# Every policy gets the idle periods of one CPU in microseconds, in the order they occurred, and returns the chosen states
+# as positions in the model; previous idle periods are known to it, the current one is not
+
+# the best choice knowing the idle time in advance, a lower bound for every policy
+def oraclePolicy(idle, model, params, recorded):
+	energy = np.where(model.allowed(params)[np.newaxis, :], model.energy(idle), np.inf)
+	return np.argmin(energy, axis=1)
+
+# what the governor of the traced system chose
+def tracePolicy(idle, model, params, recorded):
+	positions = np.searchsorted(model.index, recorded)
+	if np.any(positions >= len(model.index)) or np.any(model.index[np.minimum(positions, len(model.index) - 1)] != recorded):
+		print('The trace contains idle states that were not measured', file=sys.stderr)
+		exit(1)
+	return positions
+
+# previous idle periods, one row per idle period, NaN before the first ones
+def getHistory(idle, window):
+	padded = np.concatenate([ np.full(window, np.nan), idle[:-1] ])
+	return np.lib.stride_tricks.sliding_window_view(padded, window)
+
+# The typical interval of menu: the mean of the recent idle periods once they are close enough, discarding the longest ones
+# The trace does not tell which wakeups were timers, so without a typical interval the deepest state is chosen like for a distant timer
+def menuPolicy(idle, model, params, recorded):
+	window = int(params['window'])
+	history = np.sort(getHistory(idle, window), axis=1)
+	predicted = np.full(len(idle), np.inf)
+	for discarded in range(int(params['outliers']), -1, -1):
+		kept = history[:, :window - discarded]
+		mean = np.mean(kept, axis=1)
+		variance = np.var(kept, axis=1)
+		typical = (mean * mean > 36 * variance) | (variance <= 400)
+		predicted = np.where(typical & ~np.isnan(mean), mean, predicted)
+	return model.deepestFor(predicted, params)
+
+# teo: the deepest state for which enough of the recent idle periods, weighted by their age, were at least its target residency
+def teoPolicy(idle, model, params, recorded):
+	allowed = np.flatnonzero(model.allowed(params))
+	chosen = np.full(len(idle), allowed[0])
+	for position in allowed[1:]:
+		longEnough = pd.Series((idle >= model.residency[position]).astype(float)).shift(1, fill_value=0)
+		share = longEnough.ewm(alpha=1 - params['decay'], adjust=False).mean().to_numpy()
+		chosen = np.where(share >= params['threshold'], position, chosen)
+	return chosen
+
+policies = {
+	'oracle': oraclePolicy,
+	'trace': tracePolicy,
+	'menu': menuPolicy,
+	'teo': teoPolicy,
+}
+
+def loadCustomPolicy(path):
+	spec = importlib.util.spec_from_file_location('customPolicy', path)
+	module = importlib.util.module_from_spec(spec)
+	spec.loader.exec_module(module)
+	name = os.path.splitext(os.path.basename(path))[0]
+	policies[name] = lambda idle, model, params, recorded: module.selectStates(idle, model, params)
+	return name
+
+
+def simulate(policy, trace, model, params, rng):
+	chosen = np.empty(len(trace), dtype=int)
+	for cpu in np.unique(trace['cpu']):
+		mask = trace['cpu'] == cpu
+		chosen[mask] = policy(trace['idle'][mask] / 1000, model, params, trace['state'][mask])
+
+	idle = trace['idle'] / 1000
+	stateEnergy = model.energy(idle)
+	energy = stateEnergy[np.arange(len(trace)), chosen]
+	best = np.argmin(np.where(model.allowed(params)[np.newaxis, :], stateEnergy, np.inf), axis=1)
+	latency = np.empty(len(trace))
+	for position in range(len(model.names)):
+		mask = chosen == position
+		latency[mask] = rng.choice(model.wakeupTimes[position], size=np.count_nonzero(mask))
+
+	return {
+		'energy': np.sum(energy),
+		'idle_power': np.sum(energy) / (np.sum(idle) / 1000000),
+		# a shallower or deeper allowed state would have needed less energy
+		'too_deep': np.count_nonzero(chosen > best),
+		'too_shallow': np.count_nonzero(chosen < best),
+		'missed_deadlines': np.count_nonzero(latency > params['latency_limit']),
+		'latency_p50': np.percentile(latency, 50),
+		'latency_p99': np.percentile(latency, 99),
+		'latency_p999': np.percentile(latency, 99.9),
+		'states': ' '.join(model.names[position] + ':' + str(count) for position, count in zip(*np.unique(chosen, return_counts=True))),
+	}
+
+
+def main():
+	options, args = getopt.getopt(sys.argv[1:], 'p:P:s:h')
+	selected = None
+	customPolicies = []
+	sweeps = {}
+	for option, value in options:
+		if option == '-p':
+			selected = value.split(',')
+		elif option == '-P':
+			customPolicies.append(loadCustomPolicy(value))
+		elif option == '-s':
+			name, values = value.split('=')
+			if name not in defaultParams:
+				print('Unknown parameter ' + name, file=sys.stderr)
+				exit(1)
+			sweeps[name] = [ float(v) for v in values.split(',') ]
+		elif option == '-h':
+			help()
+			exit(0)
+	selected = selected + customPolicies if selected else list(policies)
+	traceFiles = args or [ traceFile ]
+
+	model = loadModel()
+	print('Idle states: ' + ', '.join(model.names))
+	rng = np.random.default_rng(1)
+
+	rows = []
+	for path in traceFiles:
+		trace = readTrace(path)
+		print(os.path.basename(path) + ': ' + str(len(trace)) + ' idle periods')
+		for values in itertools.product(*sweeps.values()):
+			params = dict(defaultParams, **dict(zip(sweeps.keys(), values)))
+			for name in selected:
+				result = simulate(policies[name], trace, model, params, rng)
+				parameterText = ' '.join(key + '=' + str(value) for key, value in zip(sweeps.keys(), values))
+				rows.append(dict({ 'trace': os.path.basename(path), 'policy': name, 'parameters': parameterText }, **result))
+				print('    ' + name.ljust(8) + ' ' + parameterText + ': ' + str(round(result['energy'], 4)) + ' J (' +
+				      str(round(result['idle_power'], 4)) + ' W), too deep ' + str(result['too_deep']) + ', too shallow ' +
+				      str(result['too_shallow']) + ', missed deadlines ' + str(result['missed_deadlines']) + ', latency p50/p99/p99.9 ' +
+				      '/'.join(str(round(result[key], 1)) for key in ['latency_p50', 'latency_p99', 'latency_p999']) + ' us')
+
+	pd.DataFrame(rows).to_csv(simulationFile, index=False)
+	exit(0)
+
+main()
@@ -0,0 +1,268 @@
+#!/usr/bin/env python3
+
+"""
+Synthesizes the power log an external measuring device would have recorded during the measurements in output/results,
+so that synchronization and the attribution of power values to the measurements can be tested without hardware.
+
+The true power of every measurement window is stored next to it in 'power_truth', the true clock of the log in 'meter_truth'.
+After running scripts/postProcess.py, 'synthesizePowerLog.py evaluate' compares them with the attributed 'power' and the
+recovered offset and drift in 'sync', and fails if the latter are off by more than the tolerance.
+"""
+
+import numpy as np
+import pandas as pd
+import os, sys
+import getopt
+import csv
+
+scriptDir = os.path.dirname(__file__)
+outputDir = os.path.normpath(os.path.join(scriptDir, '..', 'output'))
+resultsDir = os.path.join(outputDir, 'results')
+powerLogFile = os.path.join(outputDir, 'power_log.csv')
+meterTruthFile = os.path.join(resultsDir, 'meter_truth')
+syncFile = os.path.join(resultsDir, 'sync')
+
+# model of the measured system, in Watt
+signalHighPower = 4.0
+signalLowPower = 2.0
+idlePower = 3.0
+
+# model of the measuring device
+meter = {
+	'period': 0.1,		# seconds between two values
+	'noise': 0.02,		# standard deviation in Watt
+	'resolution': 0.001,	# Watt
+	'offset': 5.0,		# seconds the log starts before the first signal
+	'drift': 100.0,		# ppm the clock of the logger runs faster than the one of the measured system
+}
+
+# the sync points may be off by this fraction of the sampling period plus syncTolerance seconds, the drift by as much
+# as that error at both ends of the log amounts to
+syncPeriodTolerance = 0.02
+syncTolerance = 0.001
+
+def help():
+	print('Syntax: synthesizePowerLog.py [-c] [-p <period>] [-n <noise>] [-r <resolution>] [-o <offset>] [-d <drift>] [-f <file>]')
+	print('        synthesizePowerLog.py evaluate')
+	print('    -c: Create a synthetic set of measurements in output/results first')
+	print('    -p: Sampling period of the measuring device in seconds (' + str(meter['period']) + ')')
+	print('    -n: Standard deviation of the noise in Watt (' + str(meter['noise']) + ')')
+	print('    -r: Resolution of the measuring device in Watt (' + str(meter['resolution']) + ')')
+	print('    -o: Seconds the log starts before the first synchronization signal (' + str(meter['offset']) + ')')
+	print('    -d: Clock drift of the measuring device in ppm (' + str(meter['drift']) + ')')
+	print('    -f: Write the log to this file instead of output/power_log.csv, e.g. to replay it with logger/powerlog')
+
+
+def readTimes(path):
+	return pd.read_csv(path, names=['time'])['time'].to_numpy() / 1000000000
+
+def getMeasurementDirs():
+	measurementDirs = []
+	for mType in [ e.name for e in os.scandir(resultsDir) if e.is_dir() ]:
+		typeDir = os.path.join(resultsDir, mType)
+		for mName in [ e.name for e in os.scandir(typeDir) if e.is_dir() ]:
+			measurementDir = os.path.join(typeDir, mName)
+			if os.path.isfile(os.path.join(measurementDir, 'start_time')):
+				measurementDirs.append(measurementDir)
+	return measurementDirs
+
+
+# a campaign like the one of mwait_deploy/measure.sh -s: signals at the start and end, configurations with different power in between
+syntheticConfigurations = 5
+syntheticWindows = 10
+syntheticDuration = 1000
+syntheticGap = 0.5
+
+def writeTimes(path, times):
+	with open(path, 'w') as file:
+		for time in times:
+			file.write(str(int(round(time * 1000000000))) + '\n')
+
+def createCampaign():
+	os.makedirs(resultsDir, exist_ok=True)
+	duration = syntheticDuration / 1000
+	code = [1, 1, 1, 1, 1, 0, 0, 1, 1, 0, 1, 0, 1]
+	with open(os.path.join(resultsDir, 'duration'), 'w') as file:
+		file.write(str(syntheticDuration) + '\n')
+	with open(os.path.join(resultsDir, 'signal_code'), 'w') as file:
+		file.write(''.join([ str(level) + '\n' for level in code ]))
+
+	time = 1000.0
+	writeTimes(os.path.join(resultsDir, 'signal_times'), [ time + i * duration for i in range(len(code) + 1) ])
+	time += len(code) * duration + syntheticGap
+
+	for config in range(syntheticConfigurations):
+		measurementDir = os.path.join(resultsDir, 'synthetic', str(config))
+		os.makedirs(measurementDir, exist_ok=True)
+		startTimes = [ time + i * (duration + syntheticGap) for i in range(syntheticWindows) ]
+		writeTimes(os.path.join(measurementDir, 'start_time'), startTimes)
+		writeTimes(os.path.join(measurementDir, 'end_time'), [ start + duration for start in startTimes ])
+		with open(os.path.join(measurementDir, 'power_truth'), 'w') as file:
+			power = signalLowPower + config * (signalHighPower - signalLowPower) / syntheticConfigurations
+			file.write(''.join([ str(power) + '\n' for _ in startTimes ]))
+		time = startTimes[-1] + duration + syntheticGap
+
+	writeTimes(os.path.join(resultsDir, 'signal_times_end'), [ time + i * duration for i in range(len(code) + 1) ])
+
+
+# the true power of a measurement window, from the internal energy values if they exist
+def getTruePower(measurementDir, startTimes, endTimes):
+	truthFile = os.path.join(measurementDir, 'power_truth')
+	if os.path.isfile(truthFile):
+		return pd.read_csv(truthFile, names=['power'])['power'].to_numpy()
+
+	energyFile = os.path.join(measurementDir, 'energy_consumption')
+	if os.path.isfile(energyFile):
+		energy = pd.read_csv(energyFile, names=['energy'])['energy'].to_numpy() / 10000000
+		power = energy / (endTimes - startTimes)
+	else:
+		power = np.full(len(startTimes), idlePower)
+	writeColumn(truthFile, power)
+	return power
+
+def writeColumn(path, values):
+	with open(path, 'w') as file:
+		writer = csv.writer(file)
+		for value in values:
+			writer.writerow([value])
+
+
+# the power of the measured system over time as (start, end, power) segments, idle power in between
+def getSegments():
+	segments = []
+	code = pd.read_csv(os.path.join(resultsDir, 'signal_code'), names=['code'])['code'].to_numpy()
+	for signalFile in [ e.path for e in os.scandir(resultsDir) if e.is_file() and e.name.startswith('signal_times') ]:
+		signalTimes = readTimes(signalFile)
+		for i in range(len(code)):
+			segments.append((signalTimes[i], signalTimes[i+1], signalHighPower if code[i] else signalLowPower))
+
+	for measurementDir in getMeasurementDirs():
+		startTimes = readTimes(os.path.join(measurementDir, 'start_time'))
+		endTimes = readTimes(os.path.join(measurementDir, 'end_time'))
+		power = getTruePower(measurementDir, startTimes, endTimes)
+		segments += zip(startTimes, endTimes, power)
+
+	return sorted(segments)
+
+# integral of the power from the first segment on, the measuring device reports the average over each period
+def getEnergyFunction(segments):
+	times = [ segments[0][0] ]
+	energy = [ 0 ]
+	for start, end, power in segments:
+		if start > times[-1]:
+			energy.append(energy[-1] + (start - times[-1]) * idlePower)
+			times.append(start)
+		start = max(start, times[-1])
+		if end > start:
+			energy.append(energy[-1] + (end - start) * power)
+			times.append(end)
+	times, energy = np.array(times), np.array(energy)
+
+	def energyAt(t):
+		result = np.interp(t, times, energy)
+		# idle before and after all segments
+		result = np.where(t < times[0], (t - times[0]) * idlePower, result)
+		return np.where(t > times[-1], energy[-1] + (t - times[-1]) * idlePower, result)
+	return energyAt
+
+def synthesize(logFile):
+	segments = getSegments()
+	energyAt = getEnergyFunction(segments)
+
+	rate = 1 + meter['drift'] / 1000000
+	begin = segments[0][0] - meter['offset']
+	end = segments[-1][1] + meter['offset']
+	# sample times on the clock of the logger, converted to the clock of the measured system
+	logTimes = np.arange(0, (end - begin) * rate, meter['period'])
+	times = begin + logTimes / rate
+	power = (energyAt(times) - energyAt(times - meter['period'] / rate)) / (meter['period'] / rate)
+	power += np.random.default_rng().normal(0, meter['noise'], len(power))
+	power = np.round(power / meter['resolution']) * meter['resolution']
+
+	with open(meterTruthFile, 'w') as file:
+		writer = csv.writer(file)
+		writer.writerow(['begin', 'drift', 'period'])
+		writer.writerow([begin, meter['drift'], meter['period']])
+	with open(logFile, 'w') as file:
+		writer = csv.writer(file)
+		writer.writerow(['time', 'power'])
+		for time, value in zip(logTimes, power):
+			writer.writerow([round(time, 6), round(value, 6)])
+	print('Synthesized ' + str(len(logTimes)) + ' values over ' + str(round(logTimes[-1], 1)) + ' s into ' + logFile)
+
+
+# the log times of the sync points against the ones the synthesized clock gives, returns whether they are within the tolerance
+def evaluateSync():
+	if not os.path.isfile(meterTruthFile) or not os.path.isfile(syncFile):
+		print('No synchronization to evaluate', file=sys.stderr)
+		return True
+	truth = pd.read_csv(meterTruthFile).iloc[0]
+	sync = pd.read_csv(syncFile)
+	rate = 1 + truth['drift'] / 1000000
+	offsetErrors = sync['log_time'].to_numpy() - (sync['measure_time'].to_numpy() - truth['begin']) * rate
+	offsetTolerance = syncPeriodTolerance * truth['period'] + syncTolerance
+	print('Sync points: ' + str(len(sync)) + ', offset error max absolute ' + str(round(np.max(np.abs(offsetErrors)) * 1000, 2)) +
+	      ' ms (tolerance ' + str(round(offsetTolerance * 1000, 2)) + ' ms)')
+	withinTolerance = np.max(np.abs(offsetErrors)) <= offsetTolerance
+
+	if len(sync) > 1:
+		span = sync['measure_time'].max() - sync['measure_time'].min()
+		drift = (np.polyfit(sync['measure_time'], sync['log_time'], 1)[0] - 1) * 1000000
+		driftTolerance = 2 * offsetTolerance / span * 1000000
+		print('Drift: ' + str(round(drift, 1)) + ' ppm recovered, ' + str(truth['drift']) + ' ppm true (tolerance ' + str(round(driftTolerance, 1)) + ' ppm)')
+		withinTolerance &= abs(drift - truth['drift']) <= driftTolerance
+	return withinTolerance
+
+def evaluate():
+	errors = []
+	missing = 0
+	for measurementDir in getMeasurementDirs():
+		powerFile = os.path.join(measurementDir, 'power')
+		truthFile = os.path.join(measurementDir, 'power_truth')
+		if not os.path.isfile(powerFile) or not os.path.isfile(truthFile):
+			continue
+		power = pd.read_csv(powerFile, names=['power'])['power'].to_numpy()
+		truth = pd.read_csv(truthFile, names=['power'])['power'].to_numpy()
+		for value, trueValue in zip(power, truth):
+			if value < 0:
+				missing += 1
+			else:
+				errors.append(value - trueValue)
+
+	if not errors:
+		print('No power values to evaluate, run scripts/postProcess.py first', file=sys.stderr)
+		exit(1)
+	errors = np.array(errors)
+	print('Windows: ' + str(len(errors)) + ' attributed, ' + str(missing) + ' missing')
+	print('Error: mean ' + str(round(np.mean(errors), 4)) + ' W, mean absolute ' + str(round(np.mean(np.abs(errors)), 4)) +
+	      ' W, max absolute ' + str(round(np.max(np.abs(errors)), 4)) + ' W')
+	if not evaluateSync():
+		print('The recovered offset or drift of the power log is off by more than the tolerance', file=sys.stderr)
+		exit(1)
+
+
+def main():
+	options, args = getopt.getopt(sys.argv[1:], 'cp:n:r:o:d:f:h')
+	if 'evaluate' in args:
+		evaluate()
+		exit(0)
+
+	logFile = powerLogFile
+	for option, value in options:
+		if option == '-c':
+			createCampaign()
+		elif option == '-f':
+			logFile = value
+		elif option == '-h':
+			help()
+			exit(0)
+		else:
+			meter[{ '-p': 'period', '-n': 'noise', '-r': 'resolution', '-o': 'offset', '-d': 'drift' }[option]] = float(value)
+
+	if not os.path.isfile(os.path.join(resultsDir, 'signal_times')):
+		print('No synchronization signal in ' + resultsDir + ', measure with -s or create a synthetic set of measurements with -c', file=sys.stderr)
+		exit(1)
+	synthesize(logFile)
+	exit(0)
+
+main()